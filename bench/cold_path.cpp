@@ -0,0 +1,101 @@
+// Cost of the unwrap failure path at Ok call sites. LegacyResult reproduces
+// the previous shape: a std::string context built on every call, and the
+// record, hook resolution, fallback to std::cerr and terminate sequence
+// expanded inline. The current Result passes the context as two pointers
+// and jumps to one shared cold result_detail::fail.
+//
+// g++ -O2 -std=c++11 -pthread -I.. cold_path.cpp -o cold_path
+// nm -S -C --size-sort cold_path | grep -E 'sum(Current|Legacy)'
+#include "../cpp_rust_result.hpp"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+template <typename T, typename E>
+class LegacyResult {
+    T value;
+    E error;
+    bool is_ok;
+
+    static result_detail::HookOverride hooks;
+
+    void logError(const LogRecord& record) const {
+        auto hook = result_detail::resolveHook(&result_detail::HookSet::log,
+                                               &hooks, &result_detail::ErrorHooks<E>::level);
+        if (hook) (*hook)(record);
+        else std::cerr << record.text() << std::endl;
+    }
+
+    void terminateProgram() const {
+        auto flush = result_detail::resolveHook(&result_detail::HookSet::flush,
+                                                &hooks, &result_detail::ErrorHooks<E>::level);
+        if (flush) (*flush)();
+        auto hook = result_detail::resolveHook(&result_detail::HookSet::terminate,
+                                               &hooks, &result_detail::ErrorHooks<E>::level);
+        if (hook) (*hook)();
+        else std::terminate();
+    }
+
+public:
+    LegacyResult(T value) : value(value), error(), is_ok(true) {}
+
+    T unwrap(const std::string& context = "") const {
+        if (is_ok) return value;
+        LogRecord record = { LogSeverity::Fatal, LogEvent::Unwrap, context.data(), context.size(), &error,
+                             &result_detail::formatErased<E>, nullptr };
+        logError(record);
+        terminateProgram();
+        return T{};
+    }
+};
+
+template <typename T, typename E>
+result_detail::HookOverride LegacyResult<T, E>::hooks(nullptr);
+
+// several call sites per loop, as in real code that unwraps a few fields
+__attribute__((noinline)) long sumCurrent(const std::vector<Result<int, const char*> >& items) {
+    long sum = 0;
+    for (const auto& item : items) {
+        sum += item.unwrap();
+        sum += item.unwrap("field");
+        sum += item.expect("present");
+    }
+    return sum;
+}
+
+__attribute__((noinline)) long sumLegacy(const std::vector<LegacyResult<int, const char*> >& items) {
+    long sum = 0;
+    for (const auto& item : items) {
+        sum += item.unwrap();
+        sum += item.unwrap("field");
+        sum += item.unwrap("present");
+    }
+    return sum;
+}
+
+template <typename F>
+double nsPerItem(F f, std::size_t count, long& sink) {
+    const int rounds = 50;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) sink += f();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (rounds * static_cast<double>(count));
+}
+
+int main() {
+    const std::size_t count = 1 << 16;
+    std::vector<Result<int, const char*> > current;
+    std::vector<LegacyResult<int, const char*> > legacy;
+    for (std::size_t i = 0; i < count; ++i) {
+        current.push_back(Result<int, const char*>::Ok(static_cast<int>(i & 0xff)));
+        legacy.push_back(LegacyResult<int, const char*>(static_cast<int>(i & 0xff)));
+    }
+
+    long sink = 0;
+    double a = nsPerItem([&] { return sumCurrent(current); }, count, sink);
+    double b = nsPerItem([&] { return sumLegacy(legacy); }, count, sink);
+    std::printf("3 unwraps per item, all Ok\n");
+    std::printf("current (cold failure path): %.2f ns/item\n", a);
+    std::printf("legacy  (inline failure path): %.2f ns/item\n", b);
+    return sink == 42;
+}
@@ -0,0 +1,68 @@
+// An Err passed up eight layers, each adding context: by building a new
+// std::string per layer ("layer: " + error) and by withContext, which
+// pushes a frame into the thread's arena. The chain is rendered once at
+// the top in both cases, as a log hook would. Every call runs inside a
+// ContextScope, the per-request reset.
+//
+// g++ -O2 -std=c++11 -I.. context_chain.cpp -o context_chain
+#include "../cpp_rust_result_context.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+typedef Result<int, std::string> Plain;
+typedef Result<int, ContextError<std::string> > Chained;
+
+static_assert(sizeof(ContextError<std::string>) == sizeof(std::string) + sizeof(void*),
+              "an error plus one pointer, however deep the chain");
+
+__attribute__((noinline)) Plain fail() { return Plain::Err("connection refused"); }
+
+__attribute__((noinline)) Plain concatenated(int depth) {
+    if (depth == 0) return fail().mapError([](const std::string& e) { return "connecting: " + e; });
+    return concatenated(depth - 1).mapError([](const std::string& e) { return "layer: " + e; });
+}
+
+__attribute__((noinline)) Chained chained(int depth) {
+    if (depth == 0) return withContext(fail(), "connecting");
+    return withContext(chained(depth - 1), "layer");
+}
+
+template <typename F>
+double nsPerCall(F f) {
+    const int calls = 1 << 18;
+    double best = 1e30;
+    std::size_t sink = 0;
+    for (int round = 0; round < 5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; ++i) sink += f();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / calls);
+    }
+    if (sink == 42) std::puts("");
+    return best;
+}
+
+int main() {
+    const int depth = 8;
+    double plain = nsPerCall([] {
+        std::string out;
+        ErrorFormatter<std::string>::format(concatenated(depth).unwrapErr(), out);
+        return out.size();
+    });
+    double context = nsPerCall([] {
+        ContextScope scope;
+        std::string out;
+        ErrorFormatter<ContextError<std::string> >::format(chained(depth).unwrapErr(), out);
+        return out.size();
+    });
+    double unrendered = nsPerCall([] {
+        ContextScope scope;
+        return static_cast<std::size_t>(chained(depth).isErr());
+    });
+    std::printf("depth %d\n", depth);
+    std::printf("string per layer, rendered  %7.1f ns\n", plain);
+    std::printf("withContext, rendered       %7.1f ns\n", context);
+    std::printf("withContext, not rendered   %7.1f ns\n", unrendered);
+    return 0;
+}
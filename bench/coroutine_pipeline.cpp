@@ -0,0 +1,117 @@
+// The processFile shape written three ways: an andThen/map chain of
+// lambdas, RESULT_TRY_ASSIGN, and a C++20 coroutine with co_await. Each
+// step is an out-of-line function returning Result<std::string,
+// std::string>, one input in eight fails at the second step. A second run
+// uses Result<int, int> steps that do almost nothing, which leaves only
+// the cost of the control flow itself.
+//
+// g++ -O2 -std=c++20 -I.. coroutine_pipeline.cpp -o coroutine_pipeline
+#include "../cpp_rust_result.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#if !defined(CPP_RUST_RESULT_COROUTINES)
+#error "build with -std=c++20"
+#endif
+
+typedef Result<std::string, std::string> Text;
+typedef Result<double, std::string> Value;
+
+__attribute__((noinline)) Text load(const std::string& key) { return Text::Ok(key + ":payload"); }
+
+__attribute__((noinline)) Text parse(const std::string& input) {
+    if (input[0] == '0') return Text::Err("Empty input");
+    return Text::Ok("Processed: " + input);
+}
+
+__attribute__((noinline)) Value score(const std::string& text) {
+    if (text.size() > 100) return Value::Err("Value too large");
+    return Value::Ok(text.size() * 2.0);
+}
+
+Value viaChain(const std::string& key) {
+    return load(key)
+        .andThen([](const std::string& s) { return parse(s); })
+        .andThen([](const std::string& s) { return score(s); })
+        .map([](double v) { return v + 1.0; });
+}
+
+Value viaTry(const std::string& key) {
+    RESULT_TRY_ASSIGN(std::string content, load(key));
+    RESULT_TRY_ASSIGN(std::string processed, parse(content));
+    RESULT_TRY_ASSIGN(double v, score(processed));
+    return Value::Ok(v + 1.0);
+}
+
+Value viaCoroutine(const std::string& key) {
+    std::string content = co_await load(key);
+    std::string processed = co_await parse(content);
+    double v = co_await score(processed);
+    co_return v + 1.0;
+}
+
+typedef Result<int, int> Step;
+
+__attribute__((noinline)) Step bump(int x) { return (x & 7) == 7 ? Step::Err(x) : Step::Ok(x + 1); }
+
+Step bumpChain(int x) {
+    return bump(x).andThen([](int a) { return bump(a); }).andThen([](int b) { return bump(b); });
+}
+
+Step bumpTry(int x) {
+    RESULT_TRY_ASSIGN(int a, bump(x));
+    RESULT_TRY_ASSIGN(int b, bump(a));
+    return bump(b);
+}
+
+Step bumpCoroutine(int x) {
+    int a = co_await bump(x);
+    int b = co_await bump(a);
+    co_return co_await bump(b);
+}
+
+template <typename F>
+double nsPerStep(F f, long& sink) {
+    const int calls = 10000000;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < calls; ++i) sink += f(i).unwrapOr(0);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / calls;
+}
+
+template <typename F>
+double nsPerCall(F f, const std::vector<std::string>& keys, double& sink) {
+    const int rounds = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const auto& key : keys) sink += f(key).unwrapOr(-1.0);
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (rounds * static_cast<double>(keys.size()));
+}
+
+int main() {
+    std::vector<std::string> keys;
+    for (int i = 0; i < 4096; ++i) keys.push_back(std::to_string(i % 8) + "-record");
+
+    // interleaved, best of five, to keep frequency and cache effects out
+    double sink = 0.0;
+    long steps = 0;
+    double chain = 1e9, tried = 1e9, coro = 1e9;
+    double cheapChain = 1e9, cheapTry = 1e9, cheapCoro = 1e9;
+    for (int i = 0; i < 5; ++i) {
+        chain = std::min(chain, nsPerCall(viaChain, keys, sink));
+        tried = std::min(tried, nsPerCall(viaTry, keys, sink));
+        coro = std::min(coro, nsPerCall(viaCoroutine, keys, sink));
+        cheapChain = std::min(cheapChain, nsPerStep(bumpChain, steps));
+        cheapTry = std::min(cheapTry, nsPerStep(bumpTry, steps));
+        cheapCoro = std::min(cheapCoro, nsPerStep(bumpCoroutine, steps));
+    }
+    std::printf("%-14s %16s %16s\n", "ns/call", "string steps", "int steps");
+    std::printf("%-14s %16.2f %16.2f\n", "andThen chain", chain, cheapChain);
+    std::printf("%-14s %16.2f %16.2f\n", "RESULT_TRY", tried, cheapTry);
+    std::printf("%-14s %16.2f %16.2f\n", "co_await", coro, cheapCoro);
+    return sink == 42.0 && steps == 42;
+}
@@ -0,0 +1,73 @@
+// Result<double, std::string> against Result<double, ErrorId> for a divide
+// followed by a mapError that adds context, as main.cpp does with "File
+// error: " + error. One run fails every call, the other one call in 1024.
+// A replaced operator new counts the heap allocations per call.
+//
+// g++ -O2 -std=c++11 -I.. error_id.cpp -o error_id
+#include "../cpp_rust_result_error_id.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+static std::size_t allocations = 0;
+
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static_assert(sizeof(ErrorId) == 16, "a pointer and a detail");
+static_assert(std::is_trivially_copyable<Result<double, ErrorId> >::value, "register-passed like a double");
+
+__attribute__((noinline)) Result<double, std::string> divideText(double a, double b) {
+    if (b == 0.0) return Result<double, std::string>::Err("Division by zero");
+    return Result<double, std::string>::Ok(a / b);
+}
+
+__attribute__((noinline)) Result<double, ErrorId> divideId(double a, double b) {
+    if (b == 0.0) return Result<double, ErrorId>::Err(RESULT_ERROR_ID("Division by zero"));
+    return Result<double, ErrorId>::Ok(a / b);
+}
+
+static double stepText(double a, double b) {
+    return divideText(a, b)
+        .mapError([](const std::string& error) { return "Math error: " + error; })
+        .unwrapOr(0.0);
+}
+
+static double stepId(double a, double b) {
+    return divideId(a, b)
+        .mapError([](ErrorId error) { return RESULT_ERROR_ID("Math error").withDetail(error.detail()); })
+        .unwrapOr(0.0);
+}
+
+template <typename Step>
+void run(const char* name, Step step, unsigned fail_mask) {
+    const unsigned calls = 1u << 20;
+    double best = 1e30, sink = 0;
+    std::size_t before = 0, after = 0;
+    for (int round = 0; round < 5; ++round) {
+        before = allocations;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < calls; ++i) sink += step(1.0 + i, (i & fail_mask) == 0 ? 0.0 : 2.0);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        after = allocations;
+        best = std::min(best, elapsed.count() / calls);
+    }
+    std::printf("%-34s %6.1f ns/call %6.2f allocations/call\n", name, best,
+                static_cast<double>(after - before) / calls);
+    if (sink == 42) std::puts("");
+}
+
+int main() {
+    run("std::string, every call fails", stepText, 0);
+    run("ErrorId,     every call fails", stepId, 0);
+    run("std::string, 1 in 1024 fails", stepText, 1023);
+    run("ErrorId,     1 in 1024 fails", stepId, 1023);
+    return 0;
+}
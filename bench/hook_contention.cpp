@@ -0,0 +1,92 @@
+// Hook dispatch under contention: every thread recovers from Err values
+// through unwrapOrLog, so the measured cost is message building plus hook
+// dispatch. The mutex variant reproduces the previous lock-and-call scheme.
+// The slow hook spins for about a microsecond to stand in for hook I/O,
+// which the old scheme serialised across all threads.
+//
+// g++ -O2 -std=c++11 -pthread -I.. hook_contention.cpp -o hook_contention
+#include "../cpp_rust_result.hpp"
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::atomic<unsigned long> g_logged(0);
+
+void fastHook(const std::string& message) {
+    g_logged.fetch_add(message.size() != 0, std::memory_order_relaxed);
+}
+
+void slowHook(const std::string& message) {
+    auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(1);
+    while (std::chrono::steady_clock::now() < until) {}
+    fastHook(message);
+}
+
+// previous scheme: one static mutex held across the hook call
+std::mutex g_legacy_mutex;
+std::function<void(const std::string&)> g_legacy_hook;
+
+void legacyLog(const std::string& message) {
+    std::lock_guard<std::mutex> lock(g_legacy_mutex);
+    if (g_legacy_hook) g_legacy_hook(message);
+}
+
+struct SnapshotWorker {
+    int ops;
+    void operator()() const {
+        for (int i = 0; i < ops; ++i) {
+            Result<int, const char*>::Err("boom").unwrapOrLog("bench", i);
+        }
+    }
+};
+
+struct LegacyWorker {
+    int ops;
+    void operator()() const {
+        for (int i = 0; i < ops; ++i) {
+            // build the same message unwrapOrLog does, then dispatch under the lock
+            std::string context("bench");
+            legacyLog("RECOVERABLE: " + (context + ": " + std::string("boom")));
+        }
+    }
+};
+
+template <typename Worker>
+double run(int threads, Worker worker) {
+    std::vector<std::thread> pool;
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto& th : pool) th.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return threads * static_cast<double>(worker.ops) / elapsed.count();
+}
+
+void table(const char* title, void (*hook)(const std::string&), int ops) {
+    Result<int, const char*>::setLogHook(hook);
+    g_legacy_hook = hook;
+
+    std::printf("%s\n%8s %18s %18s\n", title, "threads", "snapshot ops/s", "mutex ops/s");
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        SnapshotWorker snapshot = { ops };
+        LegacyWorker legacy = { ops };
+        double a = run(threads, snapshot);
+        double b = run(threads, legacy);
+        std::printf("%8d %18.0f %18.0f\n", threads, a, b);
+    }
+    std::printf("\n");
+}
+
+} // namespace
+
+int main() {
+    std::printf("hardware threads: %u\n\n", std::thread::hardware_concurrency());
+    table("fast hook", fastHook, 200000);
+    table("slow hook (~1us)", slowHook, 20000);
+
+    Result<int, const char*>::clearHooks();
+    return g_logged.load() == 0;
+}
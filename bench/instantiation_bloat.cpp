@@ -0,0 +1,43 @@
+// Build-cost benchmark: 256 distinct Result<T, E> pairs, each used through
+// Ok/Err, map, unwrap and unwrapOrLog the way ordinary call sites do. What
+// matters is the object size and the compile time, not the run time:
+//
+// time g++ -O2 -std=c++11 -pthread -I.. -c instantiation_bloat.cpp
+// size instantiation_bloat.o
+#include "../cpp_rust_result.hpp"
+
+template <int N> struct Value { int v; };
+template <int N> struct Error { int code; };
+
+template <int N>
+struct ErrorFormatter<Error<N> > {
+    static void format(const Error<N>& err, std::string& out) { out += std::to_string(err.code); }
+};
+
+template <int N>
+__attribute__((noinline)) long exercise(long seed) {
+    typedef Result<Value<N>, Error<N> > R;
+    Value<N> value = { static_cast<int>(seed) };
+    Value<N> fallback = { 1 };
+    Error<N> error = { N };
+    long sum = R::Ok(value).map([](Value<N> v) { return v.v + N; }).unwrap("exercise");
+    sum += R::Err(error).unwrapOrLog("exercise", fallback).v;
+    return sum;
+}
+
+template <int N>
+struct Driver {
+    static long run(long seed) { return exercise<N>(seed) + Driver<N - 1>::run(seed); }
+};
+
+template <>
+struct Driver<0> {
+    static long run(long) { return 0; }
+};
+
+int main() {
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    ResultHooks::setRecordHook([](const LogRecord&) {});
+#endif
+    return Driver<256>::run(1) == 42;
+}
@@ -0,0 +1,81 @@
+// A pure, expensive andThen stage (validating and normalising a 256-byte
+// record) called with keys drawn from 1000 distinct inputs, 90% of calls
+// from the 100 hottest. Compares calling it directly, through memoize()
+// with a 256-entry cache (the copy returned by operator()), and through
+// view() (the borrowed entry), on one thread and four.
+//
+// g++ -O2 -std=c++11 -pthread -I.. memoize.cpp -o memoize
+#include "../cpp_rust_result_memo.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+typedef Result<std::string, std::string> Text;
+
+static Text normalise(const std::string& input) {
+    if (input.empty()) return Text::Err("Empty input");
+    std::string out;
+    out.reserve(input.size());
+    unsigned h = 0;
+    for (int pass = 0; pass < 8; ++pass) {
+        out.clear();
+        for (std::size_t i = 0; i < input.size(); ++i) {
+            char c = input[i];
+            h = h * 31 + static_cast<unsigned char>(c);
+            out += (c >= 'a' && c <= 'z') ? static_cast<char>(c - 32) : c;
+        }
+    }
+    if (h == 0) return Text::Err("Checksum");
+    return Text::Ok(out);
+}
+
+static std::vector<std::string> inputs;
+static std::vector<unsigned> keys;
+
+template <typename Call>
+double nsPerCall(unsigned threads, Call call) {
+    double best = 1e30;
+    for (int round = 0; round < 3; ++round) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                std::size_t sink = 0;
+                for (std::size_t i = t; i < keys.size(); i += threads) sink += call(inputs[keys[i]]);
+                if (sink == 42) std::puts("");
+            });
+        }
+        for (std::size_t t = 0; t < workers.size(); ++t) workers[t].join();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / keys.size());
+    }
+    return best;
+}
+
+int main() {
+    for (int i = 0; i < 1000; ++i) inputs.push_back(std::string(256, static_cast<char>('a' + i % 26)) + std::to_string(i));
+    std::uint32_t state = 7;
+    for (int i = 0; i < 1 << 19; ++i) {
+        state = state * 1664525u + 1013904223u;
+        keys.push_back((state >> 8) % 10 ? (state >> 12) % 100 : (state >> 12) % 1000);
+    }
+
+    auto cached = memoize(normalise, 256);
+    for (unsigned threads = 1; threads <= 4; threads *= 4) {
+        double direct = nsPerCall(threads, [](const std::string& s) { return normalise(s).unwrapOr("").size(); });
+        double copied = nsPerCall(threads, [&](const std::string& s) {
+            return Text::Ok(s).andThen(cached).unwrapOr("").size();
+        });
+        double borrowed = nsPerCall(threads, [&](const std::string& s) {
+            return cached.view(s).asRef().map([](const std::string& v) { return v.size(); }).unwrapOr(0);
+        });
+        std::printf("%u thread%s: direct %7.1f ns, memoize %7.1f ns, view %7.1f ns per call\n", threads,
+                    threads == 1 ? " " : "s", direct, copied, borrowed);
+    }
+    MemoStats stats = cached.stats();
+    std::printf("hits %llu, misses %llu (%.1f%% hit rate), evictions %llu\n",
+                static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.misses),
+                100.0 * stats.hits / (stats.hits + stats.misses), static_cast<unsigned long long>(stats.evictions));
+    return 0;
+}
@@ -0,0 +1,60 @@
+// The cost of the instrumentation counters on a loop that builds one
+// Result<double, std::string> per iteration (an Err one time in 64) and
+// recovers with unwrapOrLog into a no-op hook, from one thread and from
+// four. Build it twice and compare:
+//
+// g++ -O2 -std=c++11 -pthread -I.. metrics_overhead.cpp -o metrics_off
+// g++ -O2 -std=c++11 -pthread -I.. -DCPP_RUST_RESULT_METRICS metrics_overhead.cpp -o metrics_on
+#include "../cpp_rust_result.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+typedef Result<double, std::string> Value;
+
+__attribute__((noinline)) Value divide(double a, double b) {
+    if (b == 0.0) return Value::Err("Division by zero");
+    return Value::Ok(a / b);
+}
+
+static double loop(int calls) {
+    double sum = 0;
+    for (int i = 0; i < calls; ++i) sum += divide(i, (i & 63) ? 2.0 : 0.0).unwrapOrLog("divide", 0.0);
+    return sum;
+}
+
+static double nsPerCall(unsigned threads) {
+    const int calls = 1 << 21;
+    double best = 1e30;
+    for (int round = 0; round < 5; ++round) {
+        std::vector<std::thread> workers;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned t = 0; t < threads; ++t) workers.emplace_back([] { if (loop(calls) == 42) std::puts(""); });
+        for (std::size_t t = 0; t < workers.size(); ++t) workers[t].join();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / (static_cast<double>(calls) * threads));
+    }
+    return best;
+}
+
+int main() {
+    ResultHooks::setRecordHook([](const LogRecord&) {});
+#if defined(CPP_RUST_RESULT_METRICS)
+    std::printf("metrics on\n");
+#else
+    std::printf("metrics off\n");
+#endif
+    std::printf("1 thread   %6.2f ns/call\n", nsPerCall(1));
+    std::printf("4 threads  %6.2f ns/call\n", nsPerCall(4));
+#if defined(CPP_RUST_RESULT_METRICS)
+    std::vector<ResultMetricsEntry> rows = ResultMetrics::snapshot();
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        std::printf("%s: ok %llu, err %llu, recovered %llu\n", rows[i].type.c_str(),
+                    static_cast<unsigned long long>(rows[i].ok), static_cast<unsigned long long>(rows[i].err),
+                    static_cast<unsigned long long>(rows[i].recovered));
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Niche packing: the discriminant lives in an aligned pointer's low bit or in
+// a NicheTraits sentinel instead of a trailing bool. The static_asserts pin
+// the layouts; the benchmark scans a large batch of each layout and reports
+// the bytes touched and the time per element. Unpacked reproduces the
+// previous union-plus-bool layout.
+//
+// g++ -O2 -std=c++11 -I.. niche_layout.cpp -o niche_layout
+#include "../cpp_rust_result.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+struct Node { long payload; };
+struct Opaque;   // not opted in: stays unpacked, complete or not
+struct Done {};
+struct NotFound {};
+
+std::ostream& operator<<(std::ostream& os, NotFound) { return os << "not found"; }
+
+enum class ErrorCode : std::int32_t { DivisionByZero = 1, Overflow };
+enum class Status : std::uint8_t { Idle, Busy, Failed };
+
+template <> struct TaggedPointee<Node> : std::true_type {};
+template <> struct NicheTraits<Status> : SentinelNiche<Status, static_cast<Status>(0xff)> {};
+
+// tagged pointer
+static_assert(sizeof(Result<Node*, ErrorCode>) == sizeof(Node*), "error beside the pointer's low byte");
+static_assert(sizeof(Result<const Node*, NotFound>) == sizeof(Node*), "empty error, tag only");
+static_assert(sizeof(Result<int*, ErrorCode>) == sizeof(int*), "scalar pointees are opted in");
+static_assert(sizeof(Result<char*, ErrorCode>) == 2 * sizeof(char*), "char* has no free bit");
+static_assert(sizeof(Result<Opaque*, ErrorCode>) == 2 * sizeof(Opaque*), "no TaggedPointee");
+static_assert(sizeof(Result<Node*, const char*>) == 2 * sizeof(Node*), "error too large to share");
+// sentinel niches
+static_assert(sizeof(Result<Done, Status>) == sizeof(Status), "Ok is the sentinel");
+static_assert(sizeof(Result<Status, NotFound>) == sizeof(Status), "Err is the sentinel");
+static_assert(sizeof(Result<Done, ErrorCode>) == 2 * sizeof(ErrorCode), "no NicheTraits, unpacked");
+// Result<void, E> stores an empty Unit on success
+static_assert(sizeof(Result<void, Status>) == sizeof(Status), "void shares the sentinel");
+static_assert(sizeof(Result<void, ErrorCode>) == 2 * sizeof(ErrorCode), "bool beside E, no E on Ok");
+// Result<T&, E> stores a never-null pointer: null or the low bit marks Err
+static_assert(sizeof(Result<Node&, ErrorCode>) == sizeof(Node*), "reference, tagged");
+static_assert(sizeof(Result<const char&, NotFound>) == sizeof(char*), "reference, null niche");
+static_assert(sizeof(Result<char&, ErrorCode>) == 2 * sizeof(char*), "reference, no free bit");
+// packing keeps the trivial special members
+static_assert(std::is_trivially_copyable<Result<Node*, ErrorCode> >::value, "trivial");
+static_assert(std::is_trivially_copyable<Result<Done, Status> >::value, "trivial");
+
+template <typename T, typename E>
+struct Unpacked {
+    union {
+        T value;
+        E error;
+    };
+    bool is_ok;
+
+    bool isOk() const { return is_ok; }
+    T unwrapOr(T fallback) const { return is_ok ? value : fallback; }
+};
+
+template <typename Batch>
+double nsPerElement(Batch& batch, long& sink) {
+    const int rounds = 20;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (auto& item : batch) {
+            Node* node = item.unwrapOr(nullptr);
+            sink += node ? node->payload : -1;
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (rounds * static_cast<double>(batch.size()));
+}
+
+int main() {
+    const std::size_t count = 1 << 22;
+    Node node = { 1 };
+
+    std::vector<Result<Node*, ErrorCode> > packed;
+    std::vector<Unpacked<Node*, ErrorCode> > unpacked;
+    packed.reserve(count);
+    unpacked.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        bool ok = (i % 8) != 0;
+        if (ok) packed.push_back(Result<Node*, ErrorCode>::Ok(&node));
+        else packed.push_back(Result<Node*, ErrorCode>::Err(ErrorCode::Overflow));
+        Unpacked<Node*, ErrorCode> u;
+        u.is_ok = ok;
+        if (ok) u.value = &node;
+        else u.error = ErrorCode::Overflow;
+        unpacked.push_back(u);
+    }
+
+    long sink = 0;
+    double a = nsPerElement(packed, sink);
+    double b = nsPerElement(unpacked, sink);
+    std::printf("%zu results of <Node*, ErrorCode>\n", count);
+    std::printf("%10s %8s %10s %10s\n", "layout", "sizeof", "MiB", "ns/elem");
+    std::printf("%10s %8zu %10.1f %10.3f\n", "packed", sizeof(packed[0]),
+                count * sizeof(packed[0]) / 1048576.0, a);
+    std::printf("%10s %8zu %10.1f %10.3f\n", "unpacked", sizeof(unpacked[0]),
+                count * sizeof(unpacked[0]) / 1048576.0, b);
+    return sink == 42;
+}
@@ -0,0 +1,50 @@
+// traverse against parallelTraverse over a WorkStealingPool, for an f that
+// does a little CPU work per record (a few hundred ns), and the cost of a
+// fail-fast Err near the front of the batch: the cancelled chunks are
+// skipped rather than evaluated.
+//
+// g++ -O2 -std=c++11 -pthread -I.. parallel_traverse.cpp -o parallel_traverse
+#include "../cpp_rust_result_parallel.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+typedef Result<std::uint64_t, std::string> Checked;
+
+static Checked validate(std::uint64_t record) {
+    std::uint64_t h = record;
+    for (int i = 0; i < 64; ++i) h = (h ^ (h >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    if (record == 1000) return Checked::Err("record 1000 rejected");
+    return Checked::Ok(h);
+}
+
+template <typename F>
+double msFor(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main() {
+    const std::size_t count = 1 << 21;
+    std::vector<std::uint64_t> ok(count), failing(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        ok[i] = i + count;
+        failing[i] = i;
+    }
+    WorkStealingPool pool;
+
+    std::size_t sink = 0;
+    double serial = msFor([&] { sink += traverse(ok, validate).unwrap().size(); });
+    double parallel = msFor([&] { sink += parallelTraverse(ok, validate, pool).unwrap().size(); });
+    double cancelled = msFor([&] { sink += parallelTraverse(failing, validate, pool).isErr(); });
+    double all = msFor([&] { sink += parallelTraverseAll(failing, validate, pool).isErr(); });
+
+    std::printf("%zu records, %zu workers\n", count, pool.size());
+    std::printf("traverse                    %8.1f ms\n", serial);
+    std::printf("parallelTraverse            %8.1f ms\n", parallel);
+    std::printf("parallelTraverse, early Err %8.1f ms\n", cancelled);
+    std::printf("parallelTraverseAll         %8.1f ms\n", all);
+    return sink == 42;
+}
@@ -0,0 +1,121 @@
+// The five-stage processFile shape written as an eager andThen/map chain
+// and as a fused pipeline(), for a small payload (a short std::string, in
+// its SSO buffer) and a large one (a 1 KiB record, which a move copies).
+// The stages take their input by const& and build a new value, as the
+// lambdas in main.cpp do. A counting run reports the moves and copies
+// of the payload per call: the eager map already builds its output in the
+// new Result's storage, so the counts match and what fusion removes is the
+// intermediate Results and their state checks.
+//
+// g++ -O2 -std=c++11 -I.. pipeline_fusion.cpp -o pipeline_fusion
+#include "../cpp_rust_result_pipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+struct Large {
+    char bytes[1024];
+    std::size_t size;
+};
+
+struct Counted {
+    static int moves, copies;
+    std::string text;
+    explicit Counted(std::string text) : text(std::move(text)) {}
+    Counted(const Counted& other) : text(other.text) { ++copies; }
+    Counted(Counted&& other) : text(std::move(other.text)) { ++moves; }
+};
+int Counted::moves = 0;
+int Counted::copies = 0;
+
+template <typename T>
+struct Stages {
+    typedef Result<T, std::string> R;
+
+    static R checked(const T& value) {
+        if (Stages::sizeOf(value) == 0) return R::Err("Empty input");
+        return R::Ok(value);
+    }
+    static T tagged(const T& value) { return Stages::append(value, '+'); }
+    static R bounded(const T& value) {
+        if (Stages::sizeOf(value) > 2000) return R::Err("Value too large");
+        return R::Ok(value);
+    }
+    static T trimmed(const T& value) { return Stages::append(value, '-'); }
+    static double scored(const T& value) { return static_cast<double>(Stages::sizeOf(value)) * 2.0; }
+
+    static std::size_t sizeOf(const std::string& s) { return s.size(); }
+    static std::size_t sizeOf(const Counted& c) { return c.text.size(); }
+    static std::size_t sizeOf(const Large& l) { return l.size; }
+    static std::string append(const std::string& s, char c) { return s + c; }
+    static Counted append(const Counted& v, char c) { return Counted(v.text + c); }
+    static Large append(const Large& l, char c) {
+        Large out = l;
+        out.bytes[out.size++ % sizeof(out.bytes)] = c;
+        return out;
+    }
+
+    __attribute__((noinline)) static Result<double, std::string> eager(R source) {
+        return std::move(source)
+            .andThen(checked)
+            .map(tagged)
+            .andThen(bounded)
+            .map(trimmed)
+            .map(scored);
+    }
+
+    __attribute__((noinline)) static Result<double, std::string> fused(R source) {
+        static const auto process = pipeline()
+            .andThen(checked)
+            .map(tagged)
+            .andThen(bounded)
+            .map(trimmed)
+            .map(scored);
+        return process(std::move(source));
+    }
+};
+
+static_assert(std::is_same<decltype(Stages<std::string>::fused(Stages<std::string>::R::Ok(""))),
+                           Result<double, std::string> >::value,
+              "the pipeline ends in a single Result<double, E>");
+
+template <typename T, typename Run>
+double nsPerCall(const T& input, Run run, int iterations) {
+    double best = 1e30;
+    double sink = 0;
+    for (int round = 0; round < 5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) sink += run(Result<T, std::string>::Ok(input)).unwrapOr(0.0);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count() / iterations);
+    }
+    if (sink == 42) std::puts("");
+    return best;
+}
+
+template <typename T>
+void report(const char* name, const T& input) {
+    const int iterations = 1 << 20;
+    double eager = nsPerCall(input, Stages<T>::eager, iterations);
+    double fused = nsPerCall(input, Stages<T>::fused, iterations);
+    std::printf("%-22s eager %7.1f ns   fused %7.1f ns\n", name, eager, fused);
+}
+
+int main() {
+    Large large;
+    std::memset(large.bytes, 'x', sizeof(large.bytes));
+    large.size = 100;
+
+    report("small (std::string)", std::string("main.cpp"));
+    report("large (1 KiB record)", large);
+
+    Counted::moves = Counted::copies = 0;
+    Stages<Counted>::eager(Result<Counted, std::string>::Ok(Counted("main.cpp")));
+    int eager_moves = Counted::moves, eager_copies = Counted::copies;
+    Counted::moves = Counted::copies = 0;
+    Stages<Counted>::fused(Result<Counted, std::string>::Ok(Counted("main.cpp")));
+    std::printf("payload moves/copies  eager %d/%d   fused %d/%d\n", eager_moves, eager_copies,
+                Counted::moves, Counted::copies);
+    return 0;
+}
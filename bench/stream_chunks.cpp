@@ -0,0 +1,84 @@
+// A readFileResult -> parse -> transform pipeline over a 64 MiB file of 80-byte
+// lines: the whole file read into memory first, against streamFile with
+// 64 KiB chunks read inline and on the read-ahead thread. "Parsing" is
+// counting lines and hashing the bytes; the low bit of each hash is added
+// to the count so the hashing cannot be optimised away. Reports the time
+// and the peak resident set after each variant (getrusage; monotonic, so
+// the streams run first). The file is written to the current directory, removed
+// afterwards, and served from the page cache.
+//
+// g++ -O2 -std=c++11 -pthread -I.. stream_chunks.cpp -o stream_chunks
+#include "../cpp_rust_result_stream.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sys/resource.h>
+
+static const char* path = "stream_chunks.tmp";
+
+struct Parsed {
+    std::size_t lines;
+    std::uint64_t hash;
+};
+
+static Result<Parsed, IoError> parse(const char* begin, const char* end) {
+    Parsed out = { 0, 1469598103934665603ull };
+    for (const char* p = begin; p < end; ++p) {
+        out.lines += *p == '\n';
+        out.hash = (out.hash ^ static_cast<unsigned char>(*p)) * 1099511628211ull;
+    }
+    return Result<Parsed, IoError>::Ok(out);
+}
+
+static long peakKiB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static std::size_t streamed(bool read_ahead) {
+    StreamOptions options;
+    options.read_ahead = read_ahead;
+    auto lines = streamFile(path, options)
+        .andThen([](const Chunk& c) { return parse(c.begin(), c.end()); })
+        .map([](const Parsed& p) { return p.lines + (p.hash & 1); });
+    std::size_t total = 0;
+    for (auto& n : lines) total += n.unwrapOr(0);
+    return total;
+}
+
+static std::size_t whole() {
+    return readFileResult(path)
+        .andThen([](const MappedFile& f) { return parse(f.begin(), f.end()); })
+        .map([](const Parsed& p) { return p.lines + (p.hash & 1); })
+        .unwrapOr(0);
+}
+
+template <typename Run>
+void run(const char* name, Run body) {
+    double best = 1e30;
+    std::size_t lines = 0;
+    for (int round = 0; round < 5; ++round) {
+        auto start = std::chrono::steady_clock::now();
+        lines = body();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    std::printf("%-22s %7.1f ms  %zu lines  peak RSS %ld KiB\n", name, best, lines, peakKiB());
+}
+
+int main() {
+    {
+        std::ofstream out(path, std::ios::binary);
+        std::string line(79, 'x');
+        line += '\n';
+        for (int i = 0; i < (64 << 20) / 80; ++i) out << line;
+    }
+    std::printf("before: peak RSS %ld KiB\n", peakKiB());
+    run("streamFile, inline", [] { return streamed(false); });
+    run("streamFile, read-ahead", [] { return streamed(true); });
+    run("readFileResult, whole", whole);
+    std::remove(path);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Results of trivially copyable payloads are themselves trivially copyable,
+// so the Itanium ABI returns them in registers. LegacyResult reproduces the
+// previous layout (user-provided destructor and move, deleted copy), which
+// forces a hidden return slot in memory.
+//
+// g++ -O2 -std=c++11 -I.. trivial_layout.cpp -o trivial_layout
+// objdump -d --no-show-raw-insn trivial_layout | grep -A12 '<_Z13divideCurrent'
+#include "../cpp_rust_result.hpp"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <new>
+#include <string>
+
+enum class ErrorCode { DivisionByZero = 1 };
+
+static_assert(std::is_trivially_copyable<Result<int, int> >::value, "Result<int, int>");
+static_assert(std::is_trivially_destructible<Result<int, int> >::value, "Result<int, int>");
+static_assert(std::is_trivially_copyable<Result<double, ErrorCode> >::value, "Result<double, ErrorCode>");
+static_assert(std::is_trivially_copyable<Result<int*, const char*> >::value, "Result<int*, const char*>");
+static_assert(std::is_trivially_copyable<Result<void, ErrorCode> >::value, "Result<void, ErrorCode>");
+static_assert(!std::is_trivially_copyable<Result<std::string, int> >::value, "non-trivial payload");
+static_assert(std::is_copy_constructible<Result<std::string, int> >::value, "copyable payloads copy");
+static_assert(std::is_copy_assignable<Result<int, std::string> >::value, "copyable payloads copy");
+static_assert(std::is_copy_constructible<Result<void, std::string> >::value, "copyable payloads copy");
+static_assert(!std::is_copy_constructible<Result<std::unique_ptr<int>, int> >::value, "move-only payload");
+static_assert(!std::is_copy_constructible<Result<void, std::unique_ptr<int> > >::value, "move-only payload");
+static_assert(std::is_nothrow_move_constructible<Result<std::string, std::string> >::value, "noexcept move");
+static_assert(std::is_nothrow_move_assignable<Result<std::string, std::string> >::value, "noexcept move");
+static_assert(std::is_nothrow_move_constructible<Result<void, std::string> >::value, "noexcept move");
+
+// a lambda can be constructed but not assigned: assignment reconstructs it
+static auto increment = [](int x) { return x + 1; };
+typedef decltype(increment) Lambda;
+struct NoAssign { const std::string name; };
+static_assert(std::is_move_assignable<Result<Lambda, std::string> >::value, "assign by reconstruction");
+static_assert(std::is_move_assignable<Result<void, NoAssign> >::value, "assign by reconstruction");
+
+// trivially copyable, assignments deleted: not the trivial layout
+struct ConstMember {
+    const int id;
+};
+static_assert(std::is_trivially_copyable<ConstMember>::value, "the trait alone would pick the trivial layout");
+static_assert(std::is_move_assignable<Result<ConstMember, int> >::value, "assignable via ResultOps");
+static_assert(std::is_copy_assignable<Result<int, ConstMember> >::value, "assignable via ResultOps");
+
+struct ThrowingMove {
+    ThrowingMove() {}
+    ThrowingMove(const ThrowingMove&) {}
+    ThrowingMove(ThrowingMove&&) noexcept(false) {}
+};
+static_assert(!std::is_nothrow_move_constructible<Result<ThrowingMove, int> >::value, "honest noexcept");
+static_assert(!std::is_nothrow_move_constructible<Result<int, ThrowingMove> >::value, "honest noexcept");
+static_assert(sizeof(Result<int, int>) == 8, "no extra space for the split storage");
+
+template <typename T, typename E>
+class LegacyResult {
+    union Storage {
+        T value;
+        E error;
+        Storage() {}
+        ~Storage() {}
+    } storage;
+    bool is_ok;
+
+public:
+    LegacyResult(bool ok, T value, E error) : is_ok(ok) {
+        if (ok) new (&storage.value) T(value);
+        else new (&storage.error) E(error);
+    }
+    ~LegacyResult() {
+        if (is_ok) storage.value.~T();
+        else storage.error.~E();
+    }
+    LegacyResult(const LegacyResult&) = delete;
+    LegacyResult& operator=(const LegacyResult&) = delete;
+    LegacyResult(LegacyResult&& other) noexcept : is_ok(other.is_ok) {
+        if (is_ok) new (&storage.value) T(std::move(other.storage.value));
+        else new (&storage.error) E(std::move(other.storage.error));
+    }
+
+    bool isOk() const { return is_ok; }
+    T unwrapOr(T fallback) const { return is_ok ? storage.value : fallback; }
+};
+
+__attribute__((noinline)) Result<double, ErrorCode> divideCurrent(double a, double b) {
+    if (b == 0.0) return Result<double, ErrorCode>::Err(ErrorCode::DivisionByZero);
+    return Result<double, ErrorCode>::Ok(a / b);
+}
+
+__attribute__((noinline)) LegacyResult<double, ErrorCode> divideLegacy(double a, double b) {
+    if (b == 0.0) return LegacyResult<double, ErrorCode>(false, 0.0, ErrorCode::DivisionByZero);
+    return LegacyResult<double, ErrorCode>(true, a / b, ErrorCode::DivisionByZero);
+}
+
+template <typename F>
+double nsPerOp(F f, int iterations, double& sink) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) sink += f(static_cast<double>(i), static_cast<double>(i & 7));
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main() {
+    const int iterations = 50000000;
+    double sink = 0.0;
+    double current = nsPerOp([](double a, double b) { return divideCurrent(a, b).unwrapOr(0.0); },
+                             iterations, sink);
+    double legacy = nsPerOp([](double a, double b) { return divideLegacy(a, b).unwrapOr(0.0); },
+                            iterations, sink);
+    std::printf("sizeof(Result<double, ErrorCode>) = %zu\n", sizeof(Result<double, ErrorCode>));
+    std::printf("divide (trivial, registers): %.2f ns/op\n", current);
+    std::printf("divide (legacy, via memory): %.2f ns/op\n", legacy);
+    return sink == 42.0;
+}
@@ -1,362 +1,2348 @@
-#pragma once
-#include <utility>
-#include <string>
-#include <iostream>
-#include <sstream>
-#include <functional>
-#include <stdexcept>
-#include <mutex>
-#include <type_traits>
-
-// ---------------------------
-// Base (general T) Result<T,E>
-// ---------------------------
-template <typename T, typename E>
-class Result {
-    struct OkTag {};
-    struct ErrTag {};
-
-    union Storage {
-        T value;
-        E error;
-        Storage() {}
-        ~Storage() {}
-    } storage;
-
-    bool is_ok;
-
-    explicit Result(OkTag, T&& val) : is_ok(true) { new (&storage.value) T(std::move(val)); }
-    explicit Result(ErrTag, E&& err) : is_ok(false) { new (&storage.error) E(std::move(err)); }
-
-    // hooks
-    static std::function<void(const std::string&)> log_hook;
-    static std::function<void()> terminate_hook;
-    static std::mutex hook_mutex;
-
-    void logError(const std::string& message) const {
-        std::lock_guard<std::mutex> lock(hook_mutex);
-        if (log_hook) log_hook(message);
-        else std::cerr << message << std::endl;
-    }
-
-    void terminateProgram() const {
-        std::lock_guard<std::mutex> lock(hook_mutex);
-        if (terminate_hook) terminate_hook();
-        else std::terminate();
-    }
-
-    std::string formatError(const std::string& context) const {
-        std::string message;
-        if (!context.empty()) message = context + ": ";
-        if (!is_ok) message += errorToString(storage.error);
-        else message += "Attempted to unwrapErr an Ok value";
-        return message;
-    }
-
-    template<typename U>
-    static std::string errorToString(const U& err) {
-        std::ostringstream oss; oss << err; return oss.str();
-    }
-    static std::string errorToString(const std::string& err) { return err; }
-    static std::string errorToString(const char* err) { return err ? err : "nullptr error"; }
-
-    void destroy() {
-        if (is_ok) storage.value.~T();
-        else storage.error.~E();
-    }
-
-public:
-    // factory
-    static Result Ok(T val) { return Result(OkTag{}, std::move(val)); }
-    static Result Err(E err) { return Result(ErrTag{}, std::move(err)); }
-
-    static void setLogHook(std::function<void(const std::string&)> hook) {
-        std::lock_guard<std::mutex> lock(hook_mutex); log_hook = std::move(hook);
-    }
-    static void setTerminateHook(std::function<void()> hook) {
-        std::lock_guard<std::mutex> lock(hook_mutex); terminate_hook = std::move(hook);
-    }
-    static void clearHooks() {
-        std::lock_guard<std::mutex> lock(hook_mutex); log_hook = nullptr; terminate_hook = nullptr;
-    }
-
-    ~Result() { destroy(); }
-
-    // non-copyable
-    Result(const Result&) = delete;
-    Result& operator=(const Result&) = delete;
-
-    // movable
-    Result(Result&& other) noexcept : is_ok(other.is_ok) {
-        if (is_ok) new (&storage.value) T(std::move(other.storage.value));
-        else new (&storage.error) E(std::move(other.storage.error));
-    }
-    Result& operator=(Result&& other) noexcept {
-        if (this != &other) {
-            destroy();
-            is_ok = other.is_ok;
-            if (is_ok) new (&storage.value) T(std::move(other.storage.value));
-            else new (&storage.error) E(std::move(other.storage.error));
-        }
-        return *this;
-    }
-
-    bool isOk() const { return is_ok; }
-    bool isErr() const { return !is_ok; }
-
-    // unwrap (fatal on Err)
-    T unwrap(const std::string& context = "") {
-        if (is_ok) return std::move(storage.value);
-        auto message = formatError(context);
-        logError("FATAL: Attempted to unwrap an Err value - " + message);
-        terminateProgram();
-        return T{};
-    }
-
-    E unwrapErr(const std::string& context = "") {
-        if (!is_ok) return std::move(storage.error);
-        auto message = formatError(context);
-        logError("FATAL: Attempted to unwrapErr an Ok value - " + message);
-        terminateProgram();
-        return E{};
-    }
-
-    // unwrapOrLog: fallback default (forwarding)
-    template<typename U = T,
-             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
-    T unwrapOrLog(const std::string& context = "", U&& default_val = U{}) {
-        if (is_ok) return std::move(storage.value);
-        auto message = formatError(context);
-        logError("RECOVERABLE: " + message);
-        return T(std::forward<U>(default_val));
-    }
-
-    // unwrapChecked: returns default-constructed T on Err (document requirement)
-    T unwrapChecked() {
-        if (!is_ok) {
-            logError("Warning: Attempted to unwrapChecked an Err value");
-            return T{};
-        }
-        return std::move(storage.value);
-    }
-
-    T expect(const std::string& expectation) {
-        if (is_ok) return std::move(storage.value);
-        auto message = "Expectation failed: " + expectation + ". " + formatError("");
-        logError("FATAL: " + message);
-        terminateProgram();
-        return T{};
-    }
-
-    // unwrapOr with forwarding to support move-only types
-    template<typename U,
-             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
-    T unwrapOr(U&& default_val) {
-        if (is_ok) return std::move(storage.value);
-        return T(std::forward<U>(default_val));
-    }
-
-    // unwrapOrElse (deferred factory)
-    template<typename F>
-    T unwrapOrElse(F fallback) {
-        return is_ok ? std::move(storage.value) : fallback();
-    }
-
-    // match (observe)
-    template<typename U, typename V>
-    void match(U ok, V err) {
-        if (is_ok) ok(storage.value);
-        else err(storage.error);
-    }
-
-    // map: mapper(T&&) -> U
-    template<typename Mapper,
-             typename ReturnType = decltype(std::declval<Mapper>()(std::declval<T&&>()))>
-    auto map(Mapper mapper) -> Result<ReturnType, E> {
-        if (is_ok) {
-            return Result<ReturnType, E>::Ok(mapper(std::move(storage.value)));
-        }
-        return Result<ReturnType, E>::Err(std::move(storage.error));
-    }
-
-    // mapError
-    template<typename F,
-             typename ErrorType = decltype(std::declval<F>()(std::declval<E&&>()))>
-    auto mapError(F mapper) -> Result<T, ErrorType> {
-        if (!is_ok) {
-            return Result<T, ErrorType>::Err(mapper(std::move(storage.error)));
-        }
-        return Result<T, ErrorType>::Ok(std::move(storage.value));
-    }
-
-    // andThen (monadic bind)
-    template<typename F>
-    auto andThen(F f) -> decltype(f(std::declval<T&&>())) {
-        typedef decltype(f(std::declval<T&&>())) NextResult;
-        if (is_ok) return f(std::move(storage.value));
-        else return NextResult::Err(std::move(storage.error));
-    }
-
-    // orElse
-    template<typename F>
-    auto orElse(F f) -> decltype(f(std::declval<E&&>())) {
-        typedef decltype(f(std::declval<E&&>())) NextResult;
-        if (!is_ok) return f(std::move(storage.error));
-        else return NextResult::Ok(std::move(storage.value));
-    }
-};
-
-// static members
-template<typename T, typename E>
-std::function<void(const std::string&)> Result<T, E>::log_hook = nullptr;
-template<typename T, typename E>
-std::function<void()> Result<T, E>::terminate_hook = nullptr;
-template<typename T, typename E>
-std::mutex Result<T, E>::hook_mutex;
-
-// -----------------------------------
-// Specialization Result<void, E>
-// -----------------------------------
-template <typename E>
-class Result<void, E> {
-    struct OkTag {};
-    struct ErrTag {};
-
-    E error;          // only store error
-    bool is_ok;
-
-    explicit Result(OkTag) : error(), is_ok(true) {}
-    explicit Result(ErrTag, E&& err) : error(std::move(err)), is_ok(false) {}
-
-    static std::function<void(const std::string&)> log_hook;
-    static std::function<void()> terminate_hook;
-    static std::mutex hook_mutex;
-
-    void logError(const std::string& message) const {
-        std::lock_guard<std::mutex> lock(hook_mutex);
-        if (log_hook) log_hook(message);
-        else std::cerr << message << std::endl;
-    }
-
-    void terminateProgram() const {
-        std::lock_guard<std::mutex> lock(hook_mutex);
-        if (terminate_hook) terminate_hook();
-        else std::terminate();
-    }
-
-    std::string formatError(const std::string& context) const {
-        std::string message;
-        if (!context.empty()) message = context + ": ";
-        if (!is_ok) message += errorToString(error);
-        else message += "Attempted to unwrapErr an Ok value";
-        return message;
-    }
-
-    template<typename U>
-    static std::string errorToString(const U& err) {
-        std::ostringstream oss; oss << err; return oss.str();
-    }
-    static std::string errorToString(const std::string& err) { return err; }
-    static std::string errorToString(const char* err) { return err ? err : "nullptr error"; }
-
-public:
-    static Result Ok() { return Result(OkTag{}); }
-    static Result Err(E err) { return Result(ErrTag{}, std::move(err)); }
-
-    static void setLogHook(std::function<void(const std::string&)> hook) {
-        std::lock_guard<std::mutex> lock(hook_mutex); log_hook = std::move(hook);
-    }
-    static void setTerminateHook(std::function<void()> hook) {
-        std::lock_guard<std::mutex> lock(hook_mutex); terminate_hook = std::move(hook);
-    }
-    static void clearHooks() {
-        std::lock_guard<std::mutex> lock(hook_mutex); log_hook = nullptr; terminate_hook = nullptr;
-    }
-
-    Result() : error(), is_ok(true) {}
-    ~Result() = default;
-
-    // non-copyable
-    Result(const Result&) = delete;
-    Result& operator=(const Result&) = delete;
-
-    // movable
-    Result(Result&& o) noexcept : error(std::move(o.error)), is_ok(o.is_ok) {}
-    Result& operator=(Result&& o) noexcept { if (this!=&o){ error = std::move(o.error); is_ok = o.is_ok; } return *this; }
-
-    bool isOk() const { return is_ok; }
-    bool isErr() const { return !is_ok; }
-
-    // unwrap: void on success, fatal on err
-    void unwrap(const std::string& context = "") {
-        if (is_ok) return;
-        auto message = formatError(context);
-        logError("FATAL: Attempted to unwrap an Err value - " + message);
-        terminateProgram();
-    }
-
-    E unwrapErr(const std::string& context = "") {
-        if (!is_ok) return std::move(error);
-        auto message = formatError(context);
-        logError("FATAL: Attempted to unwrapErr an Ok value - " + message);
-        terminateProgram();
-        return E{};
-    }
-
-    // unwrapOrLog: no-op for void; but we still log if error
-    void unwrapOrLog(const std::string& context = "") {
-        if (is_ok) return;
-        auto message = formatError(context);
-        logError("RECOVERABLE: " + message);
-    }
-
-    // unwrapOrElse: accepts fallback callable invoked on Err (executes then returns void)
-    template<typename F>
-    void unwrapOrElse(F fallback) {
-        if (is_ok) return;
-        fallback();
-    }
-
-    // expect: fatal with message if Err
-    void expect(const std::string& expectation) {
-        if (is_ok) return;
-        auto message = "Expectation failed: " + expectation + ". " + formatError("");
-        logError("FATAL: " + message);
-        terminateProgram();
-    }
-
-    // map when T=void: mapper() -> U; returns Result<U,E>
-    template<typename Mapper,
-             typename ReturnType = decltype(std::declval<Mapper>()())>
-    auto map(Mapper mapper) -> Result<ReturnType, E> {
-        if (is_ok) {
-            return Result<ReturnType, E>::Ok(mapper());
-        }
-        return Result<ReturnType, E>::Err(std::move(error));
-    }
-
-    // andThen when T=void: f() -> Result<U,E>
-    template<typename F>
-    auto andThen(F f) -> decltype(f()) {
-        typedef decltype(f()) NextResult;
-        if (is_ok) return f();
-        else return NextResult::Err(std::move(error));
-    }
-
-    // orElse
-    template<typename F>
-    auto orElse(F f) -> decltype(f(std::declval<E&&>())) {
-        typedef decltype(f(std::declval<E&&>())) NextResult;
-        if (!is_ok) return f(std::move(error));
-        else return NextResult::Ok();
-    }
-};
-
-// static members for void specialization
-template<typename E>
-std::function<void(const std::string&)> Result<void, E>::log_hook = nullptr;
-template<typename E>
-std::function<void()> Result<void, E>::terminate_hook = nullptr;
-template<typename E>
-std::mutex Result<void, E>::hook_mutex;
-
+#pragma once
+#include <utility>
+#include <cstring>
+#include <string>
+#include <exception>
+#include <stdexcept>
+#include <type_traits>
+#include <functional>
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+#include <iostream>
+#include <ostream>
+#include <streambuf>
+#include <memory>
+#include <atomic>
+#endif
+#if defined(CPP_RUST_RESULT_METRICS)
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#endif
+// Clang before 17 (Apple clang before 16) converts the return object as soon
+// as get_return_object() returns, before the body has produced a Result
+#if defined(__clang__) && defined(__apple_build_version__)
+#define CPP_RUST_RESULT_EAGER_RETURN_OBJECT (__clang_major__ < 16)
+#elif defined(__clang__)
+#define CPP_RUST_RESULT_EAGER_RETURN_OBJECT (__clang_major__ < 17)
+#else
+#define CPP_RUST_RESULT_EAGER_RETURN_OBJECT 0
+#endif
+#if defined(__cpp_impl_coroutine) && __cplusplus >= 202002L && !CPP_RUST_RESULT_EAGER_RETURN_OBJECT && \
+    !defined(CPP_RUST_RESULT_NO_COROUTINES)
+#define CPP_RUST_RESULT_COROUTINES 1
+#include <coroutine>
+#include <new>
+#endif
+
+// ---------------------------
+// Structured log records
+// ---------------------------
+enum class LogSeverity { Warning, Recoverable, Fatal };
+
+// which Result operation produced the record
+enum class LogEvent { Unwrap, UnwrapErr, UnwrapOrLog, UnwrapChecked, Expect };
+
+// A call site tagged with RESULT_SITE: a constant-initialised static per
+// site, so its address is a stable identity for filtering and counting.
+struct LogSite {
+    const char* file;
+    int line;
+    const char* context;   // what the unwrap call would have been given
+};
+
+// the LogSite of this line, passed where an unwrap context goes:
+//     r.unwrapOrLog(RESULT_SITE("safe division"), 0.0);
+// literal must be a string literal
+#define RESULT_SITE(literal) \
+    ([]() -> const ::LogSite& { static const ::LogSite site = { __FILE__, __LINE__, literal }; return site; }())
+
+// What a log hook receives: nothing is formatted until the sink asks for
+// text, and then only into a caller-provided or thread-local buffer. The
+// context points at the caller's characters; it is not copied.
+struct LogRecord {
+    LogSeverity severity;
+    LogEvent event;
+    const char* context;          // unwrap context, or the expectation for Expect; may be null
+    std::size_t context_length;
+    const void* error;            // the Err value, null when there is none
+    void (*format_error)(const void* error, std::string& out);
+    const LogSite* site;          // null unless the context came from RESULT_SITE
+
+    // appends the classic "FATAL: ..." / "RECOVERABLE: ..." line to out
+    void render(std::string& out) const {
+        switch (event) {
+        case LogEvent::Unwrap:
+            out += "FATAL: Attempted to unwrap an Err value - ";
+            renderContext(out);
+            renderError(out);
+            break;
+        case LogEvent::UnwrapErr:
+            out += "FATAL: Attempted to unwrapErr an Ok value - ";
+            renderContext(out);
+            out += "Attempted to unwrapErr an Ok value";
+            break;
+        case LogEvent::UnwrapOrLog:
+            out += "RECOVERABLE: ";
+            renderContext(out);
+            renderError(out);
+            break;
+        case LogEvent::UnwrapChecked:
+            out += "Warning: Attempted to unwrapChecked an Err value";
+            break;
+        case LogEvent::Expect:
+            out += "FATAL: Expectation failed: ";
+            out.append(context ? context : "", context_length);
+            out += ". ";
+            renderError(out);
+            break;
+        }
+    }
+
+    // renders into a per-thread buffer that is reused by the next call
+    const std::string& text() const {
+        static thread_local std::string buffer;
+        buffer.clear();
+        render(buffer);
+        return buffer;
+    }
+
+    void renderError(std::string& out) const {
+        if (error && format_error) format_error(error, out);
+    }
+
+private:
+    void renderContext(std::string& out) const {
+        if (context_length) {
+            out.append(context, context_length);
+            out += ": ";
+        }
+    }
+};
+
+// ---------------------------
+// Error formatting
+// ---------------------------
+
+// Customisation point for rendering an error value; specialise for error
+// types that should not go through operator<<. format() appends to out.
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+namespace result_detail {
+
+// streambuf that appends straight into a std::string, so operator<< based
+// formatting needs no ostringstream and no intermediate copy
+class StringAppendBuf : public std::streambuf {
+public:
+    explicit StringAppendBuf(std::string& out) : out(out) {}
+
+protected:
+    int_type overflow(int_type ch) override {
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) out.push_back(traits_type::to_char_type(ch));
+        return traits_type::not_eof(ch);
+    }
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        out.append(s, static_cast<std::size_t>(n));
+        return n;
+    }
+
+private:
+    std::string& out;
+};
+
+template <typename E>
+struct HasStreamOperator {
+    template <typename U>
+    static std::true_type test(decltype(std::declval<std::ostream&>() << std::declval<const U&>())*);
+    template <typename U>
+    static std::false_type test(...);
+    static const bool value = decltype(test<E>(nullptr))::value;
+};
+
+template <typename E>
+void formatError(const E& err, std::string& out, std::false_type) {
+    StringAppendBuf buf(out);
+    std::ostream os(&buf);
+    os << err;
+}
+
+// scoped enums without operator<< print their numeric value
+template <typename E>
+void formatError(const E& err, std::string& out, std::true_type) {
+    out += std::to_string(static_cast<typename std::underlying_type<E>::type>(err));
+}
+
+} // namespace result_detail
+
+template <typename E>
+struct ErrorFormatter {
+    static void format(const E& err, std::string& out) {
+        result_detail::formatError(err, out, std::integral_constant<bool,
+            std::is_enum<E>::value && !result_detail::HasStreamOperator<E>::value>());
+    }
+};
+
+#else
+namespace result_detail {
+
+// without <ostream>: numbers and enums are printed, anything else needs a
+// specialisation of ErrorFormatter
+template <typename E>
+void formatFallback(const E& err, std::string& out, std::true_type) {
+    typedef typename std::conditional<std::is_enum<E>::value, std::underlying_type<E>,
+                                      std::enable_if<true, E> >::type::type Number;
+    out += std::to_string(static_cast<Number>(err));
+}
+
+template <typename E>
+void formatFallback(const E&, std::string& out, std::false_type) { out += "<error>"; }
+
+} // namespace result_detail
+
+template <typename E>
+struct ErrorFormatter {
+    static void format(const E& err, std::string& out) {
+        result_detail::formatFallback(err, out, std::integral_constant<bool,
+            std::is_arithmetic<E>::value || std::is_enum<E>::value>());
+    }
+};
+
+#endif
+
+template <>
+struct ErrorFormatter<std::string> {
+    static void format(const std::string& err, std::string& out) { out += err; }
+};
+
+template <>
+struct ErrorFormatter<const char*> {
+    static void format(const char* err, std::string& out) { out += err ? err : "nullptr error"; }
+};
+
+template <>
+struct ErrorFormatter<char*> {
+    static void format(const char* err, std::string& out) { ErrorFormatter<const char*>::format(err, out); }
+};
+
+// errors seen through asRef()/asMut() views format as the referenced error
+template <typename E>
+struct ErrorFormatter<std::reference_wrapper<E> > {
+    static void format(std::reference_wrapper<E> err, std::string& out) {
+        ErrorFormatter<typename std::remove_const<E>::type>::format(err.get(), out);
+    }
+};
+
+namespace result_detail {
+
+template <typename E>
+void formatErased(const void* error, std::string& out) {
+    ErrorFormatter<E>::format(*static_cast<const E*>(error), out);
+}
+
+} // namespace result_detail
+
+// ---------------------------
+// Compile-time hook policy
+// ---------------------------
+
+// Specialise ResultPolicy<E> to resolve logging and termination for every
+// Result<*, E> at compile time: the failure path calls them directly, with
+// no std::function, no atomics and no hook registry involved.
+//
+//     template <>
+//     struct ResultPolicy<SensorError> {
+//         static void log(const LogRecord& record) { uart_send(record.text().c_str()); }
+//         static void terminate() { system_reboot(); }
+//     };
+//
+// Building with CPP_RUST_RESULT_NO_DYNAMIC_HOOKS removes the runtime hooks
+// (and <iostream>, <memory>, <atomic>) altogether; the default
+// policy is then SilentPolicy.
+
+// logs nothing, terminates with std::terminate
+struct SilentPolicy {
+    static void log(const LogRecord&) {}
+    static void terminate() { std::terminate(); }
+};
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+// marker for the default policy: hooks come from ResultHooks at run time
+struct DynamicHooksPolicy {};
+
+template <typename E>
+struct ResultPolicy : DynamicHooksPolicy {};
+
+namespace result_detail {
+template <typename E>
+struct IsDynamicPolicy : std::is_base_of<DynamicHooksPolicy, ResultPolicy<E> > {};
+} // namespace result_detail
+#else
+template <typename E>
+struct ResultPolicy : SilentPolicy {};
+
+namespace result_detail {
+template <typename E>
+struct IsDynamicPolicy : std::false_type {};
+} // namespace result_detail
+#endif
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+// ---------------------------
+// Hook slot (snapshot reads)
+// ---------------------------
+namespace result_detail {
+
+// An immutable hook published as a shared_ptr snapshot. Readers copy the
+// snapshot and call it with no lock held; writers swap in a new snapshot
+// atomically, and the old hook dies with its last reader. The atomic
+// shared_ptr operations are not lock-free in libstdc++ (they take a short
+// internal spinlock around the copy), which is why engaged() lets readers
+// skip empty slots without touching them.
+template <typename Fn>
+class HookSlot {
+public:
+    typedef std::shared_ptr<const Fn> Snapshot;
+
+    Snapshot load() const {
+#if defined(__cpp_lib_atomic_shared_ptr)
+        return current.load(std::memory_order_acquire);
+#else
+        return std::atomic_load_explicit(&current, std::memory_order_acquire);
+#endif
+    }
+
+    void store(Fn fn) {
+        Snapshot next;
+        if (fn) next = std::make_shared<const Fn>(std::move(fn));
+        is_engaged.store(static_cast<bool>(next), std::memory_order_relaxed);
+#if defined(__cpp_lib_atomic_shared_ptr)
+        current.store(std::move(next), std::memory_order_release);
+#else
+        std::atomic_store_explicit(&current, std::move(next), std::memory_order_release);
+#endif
+    }
+
+    void reset() { store(Fn()); }
+
+    // cheap pre-check so empty override levels cost a single relaxed load
+    bool engaged() const { return is_engaged.load(std::memory_order_relaxed); }
+
+private:
+#if defined(__cpp_lib_atomic_shared_ptr)
+    std::atomic<Snapshot> current;
+#else
+    Snapshot current;
+#endif
+    std::atomic<bool> is_engaged{false};
+};
+
+} // namespace result_detail
+
+namespace result_detail {
+
+typedef std::function<void(const std::string&)> LogHook;
+typedef std::function<void(const LogRecord&)> RecordHook;
+typedef std::function<void()> TerminateHook;
+typedef std::function<void()> FlushHook;
+
+// string hooks keep working: the record is rendered only for them
+inline RecordHook adaptLogHook(LogHook hook) {
+    if (!hook) return RecordHook();
+    return [hook](const LogRecord& record) { hook(record.text()); };
+}
+
+struct HookSet {
+    HookSlot<RecordHook> log;
+    HookSlot<TerminateHook> terminate;
+    HookSlot<FlushHook> flush;   // drains buffered sinks before terminate
+};
+
+// process-wide hooks shared by every Result instantiation
+inline HookSet& globalHooks() {
+    static HookSet hooks;
+    return hooks;
+}
+
+// An override level (one error type, or one Result instantiation) is a
+// single atomic pointer, constant-initialised to null: a level nobody
+// installs hooks on costs no static constructor, guard or destructor. The
+// HookSet is created by the first setter and never destroyed, so hooks
+// stay callable during static destruction.
+typedef std::atomic<HookSet*> HookOverride;
+
+inline HookSet& engage(HookOverride& level) {
+    HookSet* set = level.load(std::memory_order_acquire);
+    if (set) return *set;
+    HookSet* fresh = new HookSet();
+    if (level.compare_exchange_strong(set, fresh, std::memory_order_acq_rel)) return *fresh;
+    delete fresh;   // another thread engaged it first
+    return *set;
+}
+
+inline void clearOverride(HookOverride& level) {
+    HookSet* set = level.load(std::memory_order_acquire);
+    if (!set) return;
+    set->log.reset();
+    set->terminate.reset();
+    set->flush.reset();
+}
+
+// hooks shared by every Result<*, E> with the same error type
+template <typename E>
+struct ErrorHooks {
+    static HookOverride level;
+};
+
+template <typename E>
+HookOverride ErrorHooks<E>::level(nullptr);
+
+// resolution order: Result<T,E> override, then error type, then process-wide
+template <typename Fn>
+typename HookSlot<Fn>::Snapshot resolveHook(HookSlot<Fn> HookSet::* slot,
+                                            const HookOverride* instance,
+                                            const HookOverride* error_type) {
+    typename HookSlot<Fn>::Snapshot hook;
+    const HookSet* set = instance->load(std::memory_order_acquire);
+    if (set && (set->*slot).engaged()) hook = (set->*slot).load();
+    set = error_type->load(std::memory_order_acquire);
+    if (!hook && set && (set->*slot).engaged()) hook = (set->*slot).load();
+    const HookSlot<Fn>& global = globalHooks().*slot;
+    if (!hook && global.engaged()) hook = global.load();
+    return hook;
+}
+
+} // namespace result_detail
+
+// ---------------------------
+// Process-wide hook registry
+// ---------------------------
+class ResultHooks {
+public:
+    typedef result_detail::LogHook LogHook;
+    typedef result_detail::RecordHook RecordHook;
+    typedef result_detail::TerminateHook TerminateHook;
+    typedef result_detail::FlushHook FlushHook;
+
+    // used by every Result<T,E> that has no more specific hook
+    static void setLogHook(LogHook hook) {
+        result_detail::globalHooks().log.store(result_detail::adaptLogHook(std::move(hook)));
+    }
+    static void setRecordHook(RecordHook hook) { result_detail::globalHooks().log.store(std::move(hook)); }
+    static void setTerminateHook(TerminateHook hook) {
+        result_detail::globalHooks().terminate.store(std::move(hook));
+    }
+    // called synchronously before the terminate hook so buffered FATAL lines land
+    static void setFlushHook(FlushHook hook) {
+        result_detail::globalHooks().flush.store(std::move(hook));
+    }
+    static void clearHooks() {
+        result_detail::globalHooks().log.reset();
+        result_detail::globalHooks().terminate.reset();
+        result_detail::globalHooks().flush.reset();
+    }
+
+    // keyed by error type: applies to every Result<*, E>
+    template <typename E>
+    static void setLogHook(LogHook hook) {
+        result_detail::engage(result_detail::ErrorHooks<E>::level).log.store(result_detail::adaptLogHook(std::move(hook)));
+    }
+    template <typename E>
+    static void setRecordHook(RecordHook hook) { result_detail::engage(result_detail::ErrorHooks<E>::level).log.store(std::move(hook)); }
+    template <typename E>
+    static void setTerminateHook(TerminateHook hook) {
+        result_detail::engage(result_detail::ErrorHooks<E>::level).terminate.store(std::move(hook));
+    }
+    template <typename E>
+    static void setFlushHook(FlushHook hook) {
+        result_detail::engage(result_detail::ErrorHooks<E>::level).flush.store(std::move(hook));
+    }
+    template <typename E>
+    static void clearHooks() { result_detail::clearOverride(result_detail::ErrorHooks<E>::level); }
+};
+#endif // !CPP_RUST_RESULT_NO_DYNAMIC_HOOKS
+
+// ---------------------------
+// Niche customisation point
+// ---------------------------
+
+// Declares a value of X that valid code never produces. When the other side
+// of a Result is an empty type, only X is stored and the sentinel doubles as
+// the discriminant, so sizeof(Result<Done, ErrorCode>) == sizeof(ErrorCode):
+//
+//     struct Done {};
+//     enum class ErrorCode : uint8_t { DivisionByZero = 1, Overflow };
+//     template <> struct NicheTraits<ErrorCode>
+//         : SentinelNiche<ErrorCode, static_cast<ErrorCode>(0xff)> {};
+//
+// Constructing the Result from the sentinel itself is not supported.
+template <typename X>
+struct NicheTraits {
+    static const bool available = false;
+};
+
+template <typename X, X Sentinel>
+struct SentinelNiche {
+    static const bool available = true;
+    static X sentinel() { return Sentinel; }
+    static bool isSentinel(const X& x) { return x == Sentinel; }
+};
+
+// Opts a pointee type into the tagged-pointer layout: Result<U*, E> and
+// Result<U&, E> then store a small E beside the pointer's low byte, which
+// is free when alignof(U) >= 2. Scalar pointees are opted in; a class is
+// opted in where it is complete:
+//
+//     struct Node { long payload; };
+//     template <> struct TaggedPointee<Node> : std::true_type {};
+//
+// The layout depends only on this trait, never on whether U happens to be
+// complete, so every translation unit agrees on it. Opting in a type that
+// is incomplete where the Result is instantiated is a compile error.
+template <typename U>
+struct TaggedPointee : std::is_scalar<U> {};
+
+namespace result_detail {
+
+// the pointer behind Result<T&, E>; a reference is never null, so null is
+// free to mark an empty error type
+template <typename T>
+struct RefPtr {
+    T* ptr;
+};
+
+// std::addressof without <memory>
+template <typename T>
+T* addressOf(T& ref) {
+    return reinterpret_cast<T*>(&const_cast<char&>(reinterpret_cast<const volatile char&>(ref)));
+}
+
+} // namespace result_detail
+
+template <typename T>
+struct NicheTraits<result_detail::RefPtr<T> > {
+    static const bool available = true;
+    static result_detail::RefPtr<T> sentinel() {
+        result_detail::RefPtr<T> null = { nullptr };
+        return null;
+    }
+    static bool isSentinel(const result_detail::RefPtr<T>& p) { return p.ptr == nullptr; }
+};
+
+// ---------------------------
+// Storage
+// ---------------------------
+namespace result_detail {
+
+struct OkTag {};
+struct ErrTag {};
+struct Unit {};           // the Ok payload of Result<void, E>
+
+// value returned when a terminate hook returns instead of ending the
+// program; without a default constructor there is nothing to continue with
+template <typename T>
+T fallbackValue(std::true_type) { return T{}; }
+
+template <typename T>
+T fallbackValue(std::false_type) { std::terminate(); }
+
+template <typename T>
+T fallbackValue() { return fallbackValue<T>(std::is_default_constructible<T>()); }
+
+// std::forward<Self>(self).member for an accessor result: lvalue when Self
+// is an lvalue reference (const-ness comes with X), rvalue otherwise
+template <typename Self, typename X>
+typename std::conditional<std::is_lvalue_reference<Self>::value, X&, X&&>::type
+forwardLike(X& x) {
+    return static_cast<typename std::conditional<std::is_lvalue_reference<Self>::value, X&, X&&>::type>(x);
+}
+struct OkInvokeTag {};    // payload is the prvalue returned by a callable,
+struct ErrInvokeTag {};   // initialised in place without an extra move
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 5
+template <typename T>
+struct IsTriviallyCopyable
+    : std::integral_constant<bool, __has_trivial_copy(T) && __has_trivial_assign(T) &&
+                                   __has_trivial_destructor(T)> {};
+#else
+template <typename T>
+struct IsTriviallyCopyable : std::is_trivially_copyable<T> {};
+#endif
+
+// What the trivial layouts need of a payload: trivially copyable and
+// trivially assignable both ways. A struct with a const member is
+// trivially copyable, but its assignments are deleted, so it takes the
+// ResultOps path, which assigns by reconstruction.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ < 5
+template <typename T>
+struct IsTrivialPayload : IsTriviallyCopyable<T> {};   // __has_trivial_assign is already required
+#else
+template <typename T>
+struct IsTrivialPayload
+    : std::integral_constant<bool, std::is_trivially_copyable<T>::value &&
+                                   std::is_trivially_copy_assignable<T>::value &&
+                                   std::is_trivially_move_assignable<T>::value> {};
+#endif
+
+// union plus discriminant; the destructor is trivial when both payloads' are
+template <typename T, typename E,
+          bool = std::is_trivially_destructible<T>::value && std::is_trivially_destructible<E>::value>
+struct ResultUnion {
+    union {
+        T val;
+        E err;
+    };
+    bool is_ok;
+
+    template <typename... Args>
+    explicit ResultUnion(OkTag, Args&&... args) : val(std::forward<Args>(args)...), is_ok(true) {}
+    template <typename... Args>
+    explicit ResultUnion(ErrTag, Args&&... args) : err(std::forward<Args>(args)...), is_ok(false) {}
+    template <typename F, typename... Args>
+    ResultUnion(OkInvokeTag, F&& f, Args&&... args)
+        : val(std::forward<F>(f)(std::forward<Args>(args)...)), is_ok(true) {}
+    template <typename F, typename... Args>
+    ResultUnion(ErrInvokeTag, F&& f, Args&&... args)
+        : err(std::forward<F>(f)(std::forward<Args>(args)...)), is_ok(false) {}
+
+    bool isOk() const { return is_ok; }
+    T& value() { return val; }
+    const T& value() const { return val; }
+    E& error() { return err; }
+    const E& error() const { return err; }
+
+protected:
+    explicit ResultUnion(bool ok) : is_ok(ok) {}   // payload constructed by the caller
+    void destroy() {}
+};
+
+template <typename T, typename E>
+struct ResultUnion<T, E, false> {
+    union {
+        T val;
+        E err;
+    };
+    bool is_ok;
+
+    template <typename... Args>
+    explicit ResultUnion(OkTag, Args&&... args) : val(std::forward<Args>(args)...), is_ok(true) {}
+    template <typename... Args>
+    explicit ResultUnion(ErrTag, Args&&... args) : err(std::forward<Args>(args)...), is_ok(false) {}
+    template <typename F, typename... Args>
+    ResultUnion(OkInvokeTag, F&& f, Args&&... args)
+        : val(std::forward<F>(f)(std::forward<Args>(args)...)), is_ok(true) {}
+    template <typename F, typename... Args>
+    ResultUnion(ErrInvokeTag, F&& f, Args&&... args)
+        : err(std::forward<F>(f)(std::forward<Args>(args)...)), is_ok(false) {}
+
+    bool isOk() const { return is_ok; }
+    T& value() { return val; }
+    const T& value() const { return val; }
+    E& error() { return err; }
+    const E& error() const { return err; }
+    ~ResultUnion() { destroy(); }
+
+protected:
+    explicit ResultUnion(bool ok) : is_ok(ok) {}
+    void destroy() {
+        if (is_ok) val.~T();
+        else err.~E();
+    }
+};
+
+// How ResultOps assigns from a FromT / FromE source: in place when both
+// payloads are assignable from it, else by destroying the payload and
+// constructing the new one, as assignment always did, so payloads that
+// can be constructed but not assigned (a lambda) keep their operator=.
+template <typename T, typename E, typename FromT, typename FromE>
+struct AssignPath {
+    static const bool in_place = std::is_assignable<T&, FromT>::value && std::is_assignable<E&, FromE>::value;
+    static const bool nothrow =
+        std::is_nothrow_constructible<T, FromT>::value && std::is_nothrow_constructible<E, FromE>::value &&
+        (!in_place || (std::is_nothrow_assignable<T&, FromT>::value && std::is_nothrow_assignable<E&, FromE>::value));
+};
+
+// Copy and move for non-trivial payloads. Noexcept follows T and E and the
+// assignment path taken, so std::vector growth and std::move_if_noexcept
+// pick the right path. The copy members are only instantiated when
+// ResultStorage is actually copied.
+template <typename T, typename E>
+struct ResultOps : ResultUnion<T, E> {
+    typedef AssignPath<T, E, const T&, const E&> CopyAssign;
+    typedef AssignPath<T, E, T&&, E&&> MoveAssign;
+
+    using ResultUnion<T, E>::ResultUnion;
+
+    ResultOps(const ResultOps& other)
+        noexcept(std::is_nothrow_copy_constructible<T>::value &&
+                 std::is_nothrow_copy_constructible<E>::value)
+        : ResultUnion<T, E>(other.is_ok) {
+        if (this->is_ok) new (&this->val) T(other.val);
+        else new (&this->err) E(other.err);
+    }
+
+    ResultOps(ResultOps&& other)
+        noexcept(std::is_nothrow_move_constructible<T>::value &&
+                 std::is_nothrow_move_constructible<E>::value)
+        : ResultUnion<T, E>(other.is_ok) {
+        if (this->is_ok) new (&this->val) T(std::move(other.val));
+        else new (&this->err) E(std::move(other.err));
+    }
+
+    ResultOps& operator=(const ResultOps& other) noexcept(CopyAssign::nothrow) {
+        if (this != &other) assign(other, std::integral_constant<bool, CopyAssign::in_place>());
+        return *this;
+    }
+
+    ResultOps& operator=(ResultOps&& other) noexcept(MoveAssign::nothrow) {
+        if (this != &other) assign(std::move(other), std::integral_constant<bool, MoveAssign::in_place>());
+        return *this;
+    }
+
+private:
+    template <typename Source>
+    void assign(Source&& other, std::true_type) {
+        if (this->is_ok && other.is_ok) this->val = std::forward<Source>(other).val;
+        else if (!this->is_ok && !other.is_ok) this->err = std::forward<Source>(other).err;
+        else assign(std::forward<Source>(other), std::false_type());
+    }
+
+    template <typename Source>
+    void assign(Source&& other, std::false_type) {
+        if (other.is_ok) replace(this->val, std::forward<Source>(other).val, true);
+        else replace(this->err, std::forward<Source>(other).err, false);
+    }
+
+    // switches alternative; a throwing construction happens into a
+    // temporary, before the current payload is destroyed
+    template <typename Slot, typename Source>
+    void replace(Slot& slot, Source&& source, bool ok) {
+        if (std::is_nothrow_constructible<Slot, Source&&>::value) {
+            this->destroy();
+            new (&slot) Slot(std::forward<Source>(source));
+        } else {
+            Slot tmp(std::forward<Source>(source));
+            this->destroy();
+            new (&slot) Slot(std::move(tmp));
+        }
+        this->is_ok = ok;
+    }
+};
+
+// deletes copy when a payload is not copy-constructible, leaves move alone
+template <bool Copyable>
+struct CopyControl {};
+
+template <>
+struct CopyControl<false> {
+    CopyControl() = default;
+    CopyControl(const CopyControl&) = delete;
+    CopyControl& operator=(const CopyControl&) = delete;
+    CopyControl(CopyControl&&) = default;
+    CopyControl& operator=(CopyControl&&) = default;
+};
+
+// When T and E are both trivially copyable and assignable every special
+// member stays implicit and trivial, so Result<int, int> and friends are passed and
+// returned in registers. Otherwise copy/move go through ResultOps, with
+// copy available only when both payloads are copyable.
+template <typename T, typename E,
+          bool = IsTrivialPayload<T>::value && IsTrivialPayload<E>::value>
+struct PlainStorage : ResultUnion<T, E> {
+    using ResultUnion<T, E>::ResultUnion;
+};
+
+template <typename T, typename E>
+struct PlainStorage<T, E, false>
+    : ResultOps<T, E>,
+      CopyControl<std::is_copy_constructible<T>::value && std::is_copy_constructible<E>::value> {
+    using ResultOps<T, E>::ResultOps;
+};
+
+// Compact layouts drop the separate bool. They are only used when both
+// payloads are IsTrivialPayload, so every special member stays trivial.
+//  - TaggedPointer: T points to a TaggedPointee aligned to at least 2 and
+//    E fits beside the pointer's low byte; Err sets bit 0 of that byte.
+//  - ValueNiche / ErrorNiche: one side is an empty type and the other has
+//    a NicheTraits sentinel, which stands for the empty side.
+enum class ResultLayout { Plain, TaggedPointer, ValueNiche, ErrorNiche };
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_WIN32)
+typedef std::true_type LittleEndian;
+#else
+typedef std::false_type LittleEndian;   // the tag byte must be the pointer's low byte
+#endif
+
+// every object of an empty, trivially copyable type is interchangeable
+template <typename X>
+struct IsUnitLike
+    : std::integral_constant<bool, std::is_empty<X>::value && IsTrivialPayload<X>::value &&
+                                   std::is_default_constructible<X>::value> {};
+
+template <typename X>
+struct HasNiche
+    : std::integral_constant<bool, NicheTraits<X>::available && IsTrivialPayload<X>::value> {};
+
+template <typename U, bool = TaggedPointee<typename std::remove_cv<U>::type>::value>
+struct PointeeHasFreeBit : std::false_type {};
+
+template <typename U>
+struct PointeeHasFreeBit<U, true> : std::integral_constant<bool, (alignof(U) >= 2)> {
+    static_assert(sizeof(U) > 0, "a TaggedPointee must be complete where Result<U*, E> is used");
+};
+
+template <typename P>
+struct HasFreeLowBit : std::false_type {};
+
+template <typename U>
+struct HasFreeLowBit<U*> : PointeeHasFreeBit<U> {};
+
+template <typename U>
+struct HasFreeLowBit<RefPtr<U> > : HasFreeLowBit<U*> {};
+
+// Err alternative of the TaggedPointer layout; tag overlays the low byte
+template <typename E>
+struct TaggedErr {
+    unsigned char tag;
+    E error;
+
+    template <typename... Args>
+    explicit TaggedErr(ErrTag, Args&&... args) : tag(1), error(std::forward<Args>(args)...) {}
+};
+
+template <typename T, typename E>
+struct SelectLayout {
+    static const ResultLayout value =
+        !(IsTrivialPayload<T>::value && IsTrivialPayload<E>::value) ? ResultLayout::Plain :
+        IsUnitLike<E>::value && HasNiche<T>::value ? ResultLayout::ValueNiche :
+        IsUnitLike<T>::value && HasNiche<E>::value ? ResultLayout::ErrorNiche :
+        HasFreeLowBit<T>::value && LittleEndian::value &&
+            sizeof(TaggedErr<E>) <= sizeof(T) && alignof(E) <= alignof(T) ? ResultLayout::TaggedPointer :
+        ResultLayout::Plain;
+};
+
+template <typename X>
+struct UnitInstance { static X instance; };
+
+template <typename X>
+X UnitInstance<X>::instance;
+
+// runs an empty payload's constructor for its side effects, if any
+template <typename X, typename... Args>
+void constructUnit(Args&&... args) { static_cast<void>(X(std::forward<Args>(args)...)); }
+
+template <typename F, typename... Args>
+void invokeUnit(F&& f, Args&&... args) { static_cast<void>(std::forward<F>(f)(std::forward<Args>(args)...)); }
+
+template <typename T, typename E, ResultLayout = SelectLayout<T, E>::value>
+struct ResultStorage : PlainStorage<T, E> {
+    using PlainStorage<T, E>::PlainStorage;
+};
+
+template <typename T, typename E>
+struct ResultStorage<T, E, ResultLayout::TaggedPointer> {
+    union {
+        T val;
+        TaggedErr<E> err;
+    };
+
+    template <typename... Args>
+    explicit ResultStorage(OkTag, Args&&... args) : val(std::forward<Args>(args)...) {}
+    template <typename... Args>
+    explicit ResultStorage(ErrTag, Args&&... args) : err(ErrTag{}, std::forward<Args>(args)...) {}
+    template <typename F, typename... Args>
+    ResultStorage(OkInvokeTag, F&& f, Args&&... args)
+        : val(std::forward<F>(f)(std::forward<Args>(args)...)) {}
+    template <typename F, typename... Args>
+    ResultStorage(ErrInvokeTag, F&& f, Args&&... args)
+        : err(ErrTag{}, std::forward<F>(f)(std::forward<Args>(args)...)) {}
+
+    // an aligned pointer has bit 0 clear; inspecting the byte through
+    // unsigned char is valid whichever member is active
+    bool isOk() const { return (*reinterpret_cast<const unsigned char*>(this) & 1) == 0; }
+    T& value() { return val; }
+    const T& value() const { return val; }
+    E& error() { return err.error; }
+    const E& error() const { return err.error; }
+};
+
+template <typename T, typename E>
+struct ResultStorage<T, E, ResultLayout::ValueNiche> {
+    T val;   // NicheTraits<T>::sentinel() while Err
+
+    template <typename... Args>
+    explicit ResultStorage(OkTag, Args&&... args) : val(std::forward<Args>(args)...) {}
+    template <typename... Args>
+    explicit ResultStorage(ErrTag, Args&&... args) : val(NicheTraits<T>::sentinel()) {
+        constructUnit<E>(std::forward<Args>(args)...);
+    }
+    template <typename F, typename... Args>
+    ResultStorage(OkInvokeTag, F&& f, Args&&... args)
+        : val(std::forward<F>(f)(std::forward<Args>(args)...)) {}
+    template <typename F, typename... Args>
+    ResultStorage(ErrInvokeTag, F&& f, Args&&... args) : val(NicheTraits<T>::sentinel()) {
+        invokeUnit(std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    bool isOk() const { return !NicheTraits<T>::isSentinel(val); }
+    T& value() { return val; }
+    const T& value() const { return val; }
+    E& error() { return UnitInstance<E>::instance; }
+    const E& error() const { return UnitInstance<E>::instance; }
+};
+
+template <typename T, typename E>
+struct ResultStorage<T, E, ResultLayout::ErrorNiche> {
+    E err;   // NicheTraits<E>::sentinel() while Ok
+
+    template <typename... Args>
+    explicit ResultStorage(OkTag, Args&&... args) : err(NicheTraits<E>::sentinel()) {
+        constructUnit<T>(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    explicit ResultStorage(ErrTag, Args&&... args) : err(std::forward<Args>(args)...) {}
+    template <typename F, typename... Args>
+    ResultStorage(OkInvokeTag, F&& f, Args&&... args) : err(NicheTraits<E>::sentinel()) {
+        invokeUnit(std::forward<F>(f), std::forward<Args>(args)...);
+    }
+    template <typename F, typename... Args>
+    ResultStorage(ErrInvokeTag, F&& f, Args&&... args)
+        : err(std::forward<F>(f)(std::forward<Args>(args)...)) {}
+
+    bool isOk() const { return NicheTraits<E>::isSentinel(err); }
+    T& value() { return UnitInstance<T>::instance; }
+    const T& value() const { return UnitInstance<T>::instance; }
+    E& error() { return err; }
+    const E& error() const { return err; }
+};
+
+} // namespace result_detail
+
+// ---------------------------
+// Failure paths (out of line)
+// ---------------------------
+#if defined(__GNUC__) || defined(__clang__)
+#define CPP_RUST_RESULT_LIKELY(x) __builtin_expect(!!(x), 1)
+#define CPP_RUST_RESULT_COLD __attribute__((noinline, cold))
+#elif defined(_MSC_VER)
+#define CPP_RUST_RESULT_LIKELY(x) (x)
+#define CPP_RUST_RESULT_COLD __declspec(noinline)
+#else
+#define CPP_RUST_RESULT_LIKELY(x) (x)
+#define CPP_RUST_RESULT_COLD
+#endif
+
+namespace result_detail {
+
+#if defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+struct HookSet;
+typedef HookSet* HookOverride;   // placeholder, never engaged
+#endif
+
+// Context / expectation argument of the unwrap family. Binds a string
+// literal or a std::string without constructing anything, so the Ok path
+// pays for two pointers; on failure the record points at the same
+// characters, so nothing is copied or allocated either.
+class ContextArg {
+public:
+    ContextArg(const char* text) : text(text), str(nullptr), where(nullptr) {}
+    ContextArg(const std::string& str) : text(nullptr), str(&str), where(nullptr) {}
+    ContextArg(const LogSite& site) : text(site.context), str(nullptr), where(&site) {}
+
+    const LogSite* site() const { return where; }
+
+    const char* data() const { return str ? str->data() : text; }
+    std::size_t size() const { return str ? str->size() : text ? std::strlen(text) : 0; }
+
+private:
+    const char* text;
+    const std::string* str;
+    const LogSite* where;
+};
+
+// what the failure path needs to know about E, one constant table per E
+struct FailureHandler {
+    void (*format_error)(const void*, std::string&);
+    void (*log)(const LogRecord&);    // ResultPolicy<E>; null means dynamic hooks
+    void (*terminate)();
+    HookOverride* error_hooks;        // ErrorHooks<E>::level
+};
+
+template <typename E, bool = IsDynamicPolicy<E>::value>
+struct FailurePolicy {
+    static const FailureHandler handler;
+};
+
+template <typename E, bool Dynamic>
+const FailureHandler FailurePolicy<E, Dynamic>::handler = {
+    &formatErased<E>, &ResultPolicy<E>::log, &ResultPolicy<E>::terminate, nullptr
+};
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+template <typename E>
+struct FailurePolicy<E, true> {
+    static const FailureHandler handler;
+};
+
+template <typename E>
+const FailureHandler FailurePolicy<E, true>::handler = {
+    &formatErased<E>, nullptr, nullptr, &ErrorHooks<E>::level
+};
+#endif
+
+// Logs the record and, for Fatal, flushes and terminates. A single copy
+// serves every instantiation, so a call site only sets up the arguments;
+// instance is that Result instantiation's hook override.
+CPP_RUST_RESULT_COLD inline void fail(const FailureHandler& handler, HookOverride* instance,
+                                      LogSeverity severity, LogEvent event,
+                                      const ContextArg* context, const void* error) {
+    LogRecord record = { severity, event, context ? context->data() : nullptr, context ? context->size() : 0,
+                         error, handler.format_error, context ? context->site() : nullptr };
+    if (handler.log) {
+        handler.log(record);
+        if (severity == LogSeverity::Fatal) handler.terminate();
+        return;
+    }
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    auto hook = resolveHook(&HookSet::log, instance, handler.error_hooks);
+    if (hook) (*hook)(record);
+    else std::cerr << record.text() << std::endl;
+    if (severity != LogSeverity::Fatal) return;
+
+    auto flush = resolveHook(&HookSet::flush, instance, handler.error_hooks);
+    if (flush) (*flush)();
+    auto terminate = resolveHook(&HookSet::terminate, instance, handler.error_hooks);
+    if (terminate) (*terminate)();
+    else std::terminate();
+#else
+    (void)instance;
+#endif
+}
+
+} // namespace result_detail
+
+// ---------------------------
+// Instrumentation counters
+// ---------------------------
+//
+// With CPP_RUST_RESULT_METRICS defined, every Result<T, E> instantiation
+// counts its Ok and Err constructions (factories, in-place and map/andThen
+// outputs; not copies or moves), unwrapOrLog recoveries, unwrapChecked
+// fallbacks, fatal unwraps and memoize() cache hits and misses. Each
+// instantiation has a cache-line sized shard per thread (up to 32, then
+// one shared), so threads never bounce a line between them.
+// ResultMetrics::snapshot() sums the shards for an exporter. Without the
+// macro CPP_RUST_RESULT_COUNT is empty and none of this is compiled.
+#if defined(CPP_RUST_RESULT_METRICS)
+enum class ResultMetric { Ok, Err, Recovered, CheckedFallback, Fatal, CacheHit, CacheMiss };
+
+namespace result_detail {
+
+static const std::size_t metric_kinds = 7;
+static const std::size_t metric_shards = 32;   // owned shards; one more is shared
+
+struct alignas(64) MetricShard {
+    std::atomic<std::uint64_t> counts[metric_kinds];
+};
+
+// one per instantiation, constant-initialised and registered on first use
+struct MetricsEntry {
+    const char* (*name)();
+    std::atomic<bool> registered;
+    MetricsEntry* next;
+    MetricShard shards[metric_shards + 1];
+};
+
+template <typename Unused>
+struct MetricsRegistry {
+    static std::atomic<MetricsEntry*> head;
+    static std::atomic<std::uint32_t> free_shards;   // bit i set: shard i has no owner
+};
+
+template <typename Unused>
+std::atomic<MetricsEntry*> MetricsRegistry<Unused>::head(nullptr);
+template <typename Unused>
+std::atomic<std::uint32_t> MetricsRegistry<Unused>::free_shards(0xffffffffu);
+
+CPP_RUST_RESULT_COLD inline void registerMetrics(MetricsEntry& entry) {
+    if (entry.registered.exchange(true, std::memory_order_relaxed)) return;
+    MetricsEntry* head = MetricsRegistry<void>::head.load(std::memory_order_relaxed);
+    do {
+        entry.next = head;
+    } while (!MetricsRegistry<void>::head.compare_exchange_weak(head, &entry, std::memory_order_release,
+                                                                std::memory_order_relaxed));
+}
+
+// A thread owns one shard while it lives and is its only writer, so an
+// increment is a plain load and store with no locked instruction. Threads
+// beyond metric_shards share the last shard and use fetch_add. The shard
+// is handed back at thread exit by a releaser registered with the claim.
+struct MetricThread {
+    static unsigned& shard() {
+        static thread_local unsigned index = 0;   // shard + 1, 0 until claimed
+        return index;
+    }
+
+    struct Releaser {
+        ~Releaser() {
+            unsigned index = shard();
+            shard() = metric_shards + 1;   // late counts go to the shared shard
+            if (index && index <= metric_shards) {
+                MetricsRegistry<void>::free_shards.fetch_or(1u << (index - 1), std::memory_order_release);
+            }
+        }
+    };
+
+    CPP_RUST_RESULT_COLD static unsigned claim() {
+        std::uint32_t free = MetricsRegistry<void>::free_shards.load(std::memory_order_relaxed);
+        while (free) {
+            unsigned bit = 0;
+            while (!(free & (1u << bit))) ++bit;
+            if (MetricsRegistry<void>::free_shards.compare_exchange_weak(free, free & ~(1u << bit),
+                                                                        std::memory_order_acquire)) {
+                static thread_local Releaser releaser;
+                (void)releaser;
+                return shard() = bit + 1;
+            }
+        }
+        return shard() = metric_shards + 1;
+    }
+};
+
+inline void bumpMetric(MetricsEntry& entry, std::size_t metric) {
+    unsigned index = MetricThread::shard();
+    if (!CPP_RUST_RESULT_LIKELY(index != 0)) index = MetricThread::claim();
+    std::atomic<std::uint64_t>& counter = entry.shards[index - 1].counts[metric];
+    if (CPP_RUST_RESULT_LIKELY(index <= metric_shards)) {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    } else {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+template <typename R>
+const char* metricsName() {
+#if defined(__GNUC__)
+    return __PRETTY_FUNCTION__;
+#elif defined(_MSC_VER)
+    return __FUNCSIG__;
+#else
+    return "Result";
+#endif
+}
+
+template <typename R>
+struct InstanceMetrics {
+    static MetricsEntry entry;
+
+    static void count(ResultMetric metric) {
+        if (!CPP_RUST_RESULT_LIKELY(entry.registered.load(std::memory_order_relaxed))) registerMetrics(entry);
+        bumpMetric(entry, static_cast<std::size_t>(metric));
+    }
+
+    static void countFailure(LogSeverity severity, LogEvent event) {
+        if (severity == LogSeverity::Fatal) count(ResultMetric::Fatal);
+        else if (event == LogEvent::UnwrapOrLog) count(ResultMetric::Recovered);
+        else if (event == LogEvent::UnwrapChecked) count(ResultMetric::CheckedFallback);
+    }
+};
+
+template <typename R>
+MetricsEntry InstanceMetrics<R>::entry = { &metricsName<R>, {}, nullptr, {} };
+
+// "Result<int, std::string>" out of the compiler's function signature
+inline std::string metricsTypeName(const char* signature) {
+    std::string text(signature);
+    std::string::size_type start = text.find("R = ");
+    if (start == std::string::npos) return text;
+    start += 4;
+    std::string::size_type end = text.find_first_of(";]", start);
+    return text.substr(start, end == std::string::npos ? std::string::npos : end - start);
+}
+
+} // namespace result_detail
+
+struct ResultMetricsEntry {
+    std::string type;   // e.g. "Result<double, std::__cxx11::basic_string<char> >"
+    std::uint64_t ok;
+    std::uint64_t err;
+    std::uint64_t recovered;          // unwrapOrLog on an Err
+    std::uint64_t checked_fallbacks;  // unwrapChecked on an Err
+    std::uint64_t fatal;              // unwrap / unwrapErr / expect failures
+    std::uint64_t cache_hits;         // memoize() calls answered from the cache
+    std::uint64_t cache_misses;       // memoize() calls that ran the function
+};
+
+class ResultMetrics {
+public:
+    // instantiations that have counted anything, most recently first; the
+    // sums are not a consistent cut while other threads keep counting
+    static std::vector<ResultMetricsEntry> snapshot() {
+        std::vector<ResultMetricsEntry> out;
+        for (result_detail::MetricsEntry* entry =
+                 result_detail::MetricsRegistry<void>::head.load(std::memory_order_acquire);
+             entry; entry = entry->next) {
+            std::uint64_t sums[result_detail::metric_kinds] = {};
+            for (std::size_t s = 0; s <= result_detail::metric_shards; ++s) {
+                for (std::size_t k = 0; k < result_detail::metric_kinds; ++k) {
+                    sums[k] += entry->shards[s].counts[k].load(std::memory_order_relaxed);
+                }
+            }
+            ResultMetricsEntry row = { result_detail::metricsTypeName(entry->name()),
+                                       sums[0], sums[1], sums[2], sums[3], sums[4], sums[5], sums[6] };
+            out.push_back(row);
+        }
+        return out;
+    }
+};
+
+#define CPP_RUST_RESULT_COUNT(R, metric) ::result_detail::InstanceMetrics<R>::count(metric)
+#define CPP_RUST_RESULT_COUNT_FAILURE(R, severity, event) \
+    ::result_detail::InstanceMetrics<R>::countFailure(severity, event)
+#else
+#define CPP_RUST_RESULT_COUNT(R, metric) ((void)0)
+#define CPP_RUST_RESULT_COUNT_FAILURE(R, severity, event) ((void)0)
+#endif
+
+// ---------------------------
+// Early return (RESULT_TRY)
+// ---------------------------
+namespace result_detail {
+
+// The error of a failed Result on its way out of RESULT_TRY. Points into
+// the failed Result, which outlives the return statement, and converts
+// into the caller's Result<U, E>: the error is moved (copied from an
+// lvalue) straight into the new storage.
+template <typename Ref>
+struct ErrForward {
+    typename std::remove_reference<Ref>::type* error;
+
+    Ref get() const { return static_cast<Ref>(*error); }
+};
+
+// RESULT_TRY yields the payload itself; Result<T&, E> stores a pointer
+template <typename Stored>
+struct TryPayload {
+    template <typename X>
+    static X&& get(X&& x) { return std::forward<X>(x); }
+};
+
+template <typename T>
+struct TryPayload<RefPtr<T> > {
+    static T& get(const RefPtr<T>& ref) { return *ref.ptr; }
+};
+
+// storage access for RESULT_TRY and the batch helpers, without the unwrap
+// failure path
+struct TryAccess {
+    template <typename R>
+    static bool ok(const R& r) { return r.storage.isOk(); }
+
+    template <typename R,
+              typename Stored = typename std::decay<decltype(std::declval<R&>().storage.value())>::type>
+    static auto value(R&& r) -> decltype(TryPayload<Stored>::get(forwardLike<R>(r.storage.value()))) {
+        return TryPayload<Stored>::get(forwardLike<R>(r.storage.value()));
+    }
+
+    template <typename R,
+              typename Ref = decltype(forwardLike<R>(std::declval<R&>().storage.error()))>
+    static ErrForward<Ref> error(R&& r) {
+        ErrForward<Ref> forward = { addressOf(r.storage.error()) };
+        return forward;
+    }
+};
+
+} // namespace result_detail
+
+#define CPP_RUST_RESULT_CONCAT_(a, b) a##b
+#define CPP_RUST_RESULT_CONCAT(a, b) CPP_RUST_RESULT_CONCAT_(a, b)
+
+// RESULT_TRY(expr): the Ok payload of expr, or return its error from the
+// enclosing function, whose return type must be a Result whose error type
+// is constructible from expr's. An rvalue Result is consumed, an lvalue
+// copied from. One branch; the error is never formatted or logged.
+//
+// Yielding a value needs GCC/Clang statement expressions; elsewhere
+// RESULT_TRY is a statement that only propagates, and
+// RESULT_TRY_ASSIGN(decl, expr) is the portable form of
+// `decl = RESULT_TRY(expr);`.
+#if defined(__GNUC__)
+#define RESULT_TRY(...) __extension__({ \
+    auto&& cpp_rust_result_try_ = (__VA_ARGS__); \
+    if (!CPP_RUST_RESULT_LIKELY(::result_detail::TryAccess::ok(cpp_rust_result_try_))) \
+        return ::result_detail::TryAccess::error( \
+            static_cast<decltype(cpp_rust_result_try_)&&>(cpp_rust_result_try_)); \
+    ::result_detail::TryAccess::value(static_cast<decltype(cpp_rust_result_try_)&&>(cpp_rust_result_try_)); })
+#else
+#define RESULT_TRY(...) do { \
+    auto&& cpp_rust_result_try_ = (__VA_ARGS__); \
+    if (!::result_detail::TryAccess::ok(cpp_rust_result_try_)) \
+        return ::result_detail::TryAccess::error( \
+            static_cast<decltype(cpp_rust_result_try_)&&>(cpp_rust_result_try_)); \
+} while (0)
+#endif
+
+#if defined(__COUNTER__)
+#define CPP_RUST_RESULT_UNIQUE(name) CPP_RUST_RESULT_CONCAT(name, __COUNTER__)
+#else
+#define CPP_RUST_RESULT_UNIQUE(name) CPP_RUST_RESULT_CONCAT(name, __LINE__)
+#endif
+
+#define RESULT_TRY_ASSIGN(decl, ...) \
+    RESULT_TRY_ASSIGN_IMPL_(CPP_RUST_RESULT_UNIQUE(cpp_rust_result_try_), decl, __VA_ARGS__)
+#define RESULT_TRY_ASSIGN_IMPL_(tmp, decl, ...) \
+    auto&& tmp = (__VA_ARGS__); \
+    if (!CPP_RUST_RESULT_LIKELY(::result_detail::TryAccess::ok(tmp))) \
+        return ::result_detail::TryAccess::error(static_cast<decltype(tmp)&&>(tmp)); \
+    decl = ::result_detail::TryAccess::value(static_cast<decltype(tmp)&&>(tmp))
+
+// ---------------------------
+// Base (general T) Result<T,E>
+// ---------------------------
+template <typename T, typename E>
+class Result {
+    typedef result_detail::OkTag OkTag;
+    typedef result_detail::ErrTag ErrTag;
+
+    // trivially copyable (and register-passed) when T and E are, and niche
+    // packed when the discriminant fits in spare bits or a sentinel
+    result_detail::ResultStorage<T, E> storage;
+
+    typedef result_detail::OkInvokeTag OkInvokeTag;
+    typedef result_detail::ErrInvokeTag ErrInvokeTag;
+
+    template <typename... Args>
+    explicit Result(OkTag, Args&&... args) : storage(OkTag{}, std::forward<Args>(args)...) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Ok);
+    }
+    template <typename... Args>
+    explicit Result(ErrTag, Args&&... args) : storage(ErrTag{}, std::forward<Args>(args)...) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+    template <typename F, typename... Args>
+    Result(OkInvokeTag, F&& f, Args&&... args)
+        : storage(OkInvokeTag{}, std::forward<F>(f), std::forward<Args>(args)...) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Ok);
+    }
+    template <typename F, typename... Args>
+    Result(ErrInvokeTag, F&& f, Args&&... args)
+        : storage(ErrInvokeTag{}, std::forward<F>(f), std::forward<Args>(args)...) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+
+    template <typename, typename> friend class Result;   // map & co. build in place
+    friend struct result_detail::TryAccess;
+
+    // hooks
+    typedef result_detail::IsDynamicPolicy<E> DynamicHooks;
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    typedef result_detail::LogHook LogHook;
+    typedef result_detail::RecordHook RecordHook;
+    typedef result_detail::TerminateHook TerminateHook;
+    static result_detail::HookOverride hooks;   // opt-in per-instantiation override
+    static result_detail::HookOverride* instanceHooks() { return &hooks; }
+#else
+    static result_detail::HookOverride* instanceHooks() { return nullptr; }
+#endif
+
+    // everything past the check lives in result_detail::fail
+    static void fail(LogSeverity severity, LogEvent event,
+                     const result_detail::ContextArg* context, const void* error) {
+        CPP_RUST_RESULT_COUNT_FAILURE(Result, severity, event);
+        result_detail::fail(result_detail::FailurePolicy<E>::handler, instanceHooks(),
+                            severity, event, context, error);
+    }
+
+public:
+    // factory
+    static Result Ok(const T& val) { return Result(OkTag{}, val); }
+    static Result Ok(T&& val) { return Result(OkTag{}, std::move(val)); }
+    static Result Err(const E& err) { return Result(ErrTag{}, err); }
+    static Result Err(E&& err) { return Result(ErrTag{}, std::move(err)); }
+
+    // the error returned by RESULT_TRY from a Result<U, E2>
+    template <typename Ref, typename = typename std::enable_if<std::is_convertible<Ref, E>::value>::type>
+    Result(result_detail::ErrForward<Ref> forward) : storage(ErrTag{}, forward.get()) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+
+    // construct the payload directly in the storage from constructor
+    // arguments; with C++17 this also works for non-movable T and E
+    template <typename... Args>
+    static Result inPlaceOk(Args&&... args) { return Result(OkTag{}, std::forward<Args>(args)...); }
+    template <typename... Args>
+    static Result inPlaceErr(Args&&... args) { return Result(ErrTag{}, std::forward<Args>(args)...); }
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    // per-instantiation override of the ResultHooks registry; safe to call
+    // while other threads are logging through the old hook
+    static void setLogHook(LogHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).log.store(result_detail::adaptLogHook(std::move(hook)));
+    }
+    static void setRecordHook(RecordHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).log.store(std::move(hook));
+    }
+    static void setTerminateHook(TerminateHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).terminate.store(std::move(hook));
+    }
+    static void clearHooks() { result_detail::clearOverride(hooks); }
+#endif
+
+    // copy/move/destroy come from the storage: trivial when T and E are
+    // trivially copyable, copyable when both are copyable, noexcept when
+    // both payloads' operations are
+
+    bool isOk() const { return storage.isOk(); }
+    bool isErr() const { return !storage.isOk(); }
+
+    // Accessors and combinators come as &, const& and &&. The accessors
+    // that return a T or an E move it out of a non-const Result, as they
+    // always have, and copy it out of a const one. Combinators consume a
+    // non-const Result too and only copy from a const one; match observes.
+    // Borrow through asRef()/asMut() to keep the Result intact.
+
+    // unwrap (fatal on Err)
+    T unwrap(result_detail::ContextArg context = "") & {
+        return unwrapImpl(std::move(*this), context);
+    }
+    T unwrap(result_detail::ContextArg context = "") const& {
+        return unwrapImpl(*this, context);
+    }
+    T unwrap(result_detail::ContextArg context = "") && {
+        return unwrapImpl(std::move(*this), context);
+    }
+
+    E unwrapErr(result_detail::ContextArg context = "") & {
+        return unwrapErrImpl(std::move(*this), context);
+    }
+    E unwrapErr(result_detail::ContextArg context = "") const& {
+        return unwrapErrImpl(*this, context);
+    }
+    E unwrapErr(result_detail::ContextArg context = "") && {
+        return unwrapErrImpl(std::move(*this), context);
+    }
+
+    // unwrapOrLog: fallback default (forwarding)
+    template<typename U = T,
+             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
+    T unwrapOrLog(result_detail::ContextArg context = "", U&& default_val = U{}) & {
+        return unwrapOrLogImpl(std::move(*this), context, std::forward<U>(default_val));
+    }
+    template<typename U = T,
+             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
+    T unwrapOrLog(result_detail::ContextArg context = "", U&& default_val = U{}) const& {
+        return unwrapOrLogImpl(*this, context, std::forward<U>(default_val));
+    }
+    template<typename U = T,
+             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
+    T unwrapOrLog(result_detail::ContextArg context = "", U&& default_val = U{}) && {
+        return unwrapOrLogImpl(std::move(*this), context, std::forward<U>(default_val));
+    }
+
+    // unwrapChecked: returns default-constructed T on Err (document requirement)
+    T unwrapChecked() & { return unwrapCheckedImpl(std::move(*this)); }
+    T unwrapChecked() const& { return unwrapCheckedImpl(*this); }
+    T unwrapChecked() && { return unwrapCheckedImpl(std::move(*this)); }
+
+    T expect(result_detail::ContextArg expectation) & {
+        return expectImpl(std::move(*this), expectation);
+    }
+    T expect(result_detail::ContextArg expectation) const& {
+        return expectImpl(*this, expectation);
+    }
+    T expect(result_detail::ContextArg expectation) && {
+        return expectImpl(std::move(*this), expectation);
+    }
+
+    // unwrapOr with forwarding to support move-only types
+    template<typename U,
+             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
+    T unwrapOr(U&& default_val) & {
+        if (storage.isOk()) return std::move(storage.value());
+        return T(std::forward<U>(default_val));
+    }
+    template<typename U,
+             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
+    T unwrapOr(U&& default_val) const& {
+        if (storage.isOk()) return storage.value();
+        return T(std::forward<U>(default_val));
+    }
+    template<typename U,
+             typename = typename std::enable_if<std::is_constructible<T, U&&>::value>::type>
+    T unwrapOr(U&& default_val) && {
+        if (storage.isOk()) return std::move(storage.value());
+        return T(std::forward<U>(default_val));
+    }
+
+    // unwrapOrElse (deferred factory)
+    template<typename F>
+    T unwrapOrElse(F fallback) & {
+        return storage.isOk() ? std::move(storage.value()) : fallback();
+    }
+    template<typename F>
+    T unwrapOrElse(F fallback) const& {
+        return storage.isOk() ? T(storage.value()) : fallback();
+    }
+    template<typename F>
+    T unwrapOrElse(F fallback) && {
+        return storage.isOk() ? std::move(storage.value()) : fallback();
+    }
+
+    // match (observe)
+    template<typename U, typename V>
+    void match(U ok, V err) & { matchImpl(*this, ok, err); }
+    template<typename U, typename V>
+    void match(U ok, V err) const& { matchImpl(*this, ok, err); }
+    template<typename U, typename V>
+    void match(U ok, V err) && { matchImpl(std::move(*this), ok, err); }
+
+    // borrowing views: no copy of T or E, the Result must outlive the view
+    typedef Result<std::reference_wrapper<const T>, std::reference_wrapper<const E> > ConstView;
+    typedef Result<std::reference_wrapper<T>, std::reference_wrapper<E> > MutView;
+
+    ConstView asRef() const& {
+        if (storage.isOk()) return ConstView(OkTag{}, std::cref(storage.value()));
+        return ConstView(ErrTag{}, std::cref(storage.error()));
+    }
+    ConstView asRef() const&& = delete;   // would dangle
+
+    MutView asMut() & {
+        if (storage.isOk()) return MutView(OkTag{}, std::ref(storage.value()));
+        return MutView(ErrTag{}, std::ref(storage.error()));
+    }
+
+    // map: mapper(T) -> U; the returned U is built straight in the new
+    // Result's storage, no intermediate move
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()(std::declval<T&&>()))>
+    Result<ReturnType, E> map(Mapper mapper) & { return mapImpl<ReturnType>(std::move(*this), mapper); }
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()(std::declval<const T&>()))>
+    Result<ReturnType, E> map(Mapper mapper) const& { return mapImpl<ReturnType>(*this, mapper); }
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()(std::declval<T&&>()))>
+    Result<ReturnType, E> map(Mapper mapper) && { return mapImpl<ReturnType>(std::move(*this), mapper); }
+
+    // mapInPlace<U>: mapper(T) returns anything U is constructible from
+    // and U is constructed from it directly in the new storage, e.g.
+    //     r.mapInPlace<std::string>([](const char* s) { return s; })
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) & { return mapInPlaceImpl<U>(std::move(*this), mapper); }
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) const& { return mapInPlaceImpl<U>(*this, mapper); }
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) && { return mapInPlaceImpl<U>(std::move(*this), mapper); }
+
+    // mapError
+    template<typename F,
+             typename ErrorType = decltype(std::declval<F&>()(std::declval<E&&>()))>
+    Result<T, ErrorType> mapError(F mapper) & { return mapErrorImpl<ErrorType>(std::move(*this), mapper); }
+    template<typename F,
+             typename ErrorType = decltype(std::declval<F&>()(std::declval<const E&>()))>
+    Result<T, ErrorType> mapError(F mapper) const& { return mapErrorImpl<ErrorType>(*this, mapper); }
+    template<typename F,
+             typename ErrorType = decltype(std::declval<F&>()(std::declval<E&&>()))>
+    Result<T, ErrorType> mapError(F mapper) && { return mapErrorImpl<ErrorType>(std::move(*this), mapper); }
+
+    // andThen (monadic bind)
+    template<typename F>
+    auto andThen(F f) & -> decltype(f(std::declval<T&&>())) { return andThenImpl(std::move(*this), f); }
+    template<typename F>
+    auto andThen(F f) const& -> decltype(f(std::declval<const T&>())) { return andThenImpl(*this, f); }
+    template<typename F>
+    auto andThen(F f) && -> decltype(f(std::declval<T&&>())) { return andThenImpl(std::move(*this), f); }
+
+    // orElse
+    template<typename F>
+    auto orElse(F f) & -> decltype(f(std::declval<E&&>())) { return orElseImpl(std::move(*this), f); }
+    template<typename F>
+    auto orElse(F f) const& -> decltype(f(std::declval<const E&>())) { return orElseImpl(*this, f); }
+    template<typename F>
+    auto orElse(F f) && -> decltype(f(std::declval<E&&>())) { return orElseImpl(std::move(*this), f); }
+
+private:
+    // shared bodies; Self is const Result&, Result& or Result, and
+    // forwardLike<Self> copies from lvalues and moves from rvalues
+    template<typename Self>
+    static T unwrapImpl(Self&& self, result_detail::ContextArg context) {
+        if (CPP_RUST_RESULT_LIKELY(self.storage.isOk())) {
+            return result_detail::forwardLike<Self>(self.storage.value());
+        }
+        fail(LogSeverity::Fatal, LogEvent::Unwrap, &context, &self.storage.error());
+        return result_detail::fallbackValue<T>();
+    }
+
+    template<typename Self>
+    static E unwrapErrImpl(Self&& self, result_detail::ContextArg context) {
+        if (CPP_RUST_RESULT_LIKELY(!self.storage.isOk())) {
+            return result_detail::forwardLike<Self>(self.storage.error());
+        }
+        fail(LogSeverity::Fatal, LogEvent::UnwrapErr, &context, nullptr);
+        return result_detail::fallbackValue<E>();
+    }
+
+    template<typename Self, typename U>
+    static T unwrapOrLogImpl(Self&& self, result_detail::ContextArg context, U&& default_val) {
+        if (CPP_RUST_RESULT_LIKELY(self.storage.isOk())) {
+            return result_detail::forwardLike<Self>(self.storage.value());
+        }
+        fail(LogSeverity::Recoverable, LogEvent::UnwrapOrLog, &context, &self.storage.error());
+        return T(std::forward<U>(default_val));
+    }
+
+    template<typename Self>
+    static T unwrapCheckedImpl(Self&& self) {
+        if (!CPP_RUST_RESULT_LIKELY(self.storage.isOk())) {
+            fail(LogSeverity::Warning, LogEvent::UnwrapChecked, nullptr, &self.storage.error());
+            return T{};
+        }
+        return result_detail::forwardLike<Self>(self.storage.value());
+    }
+
+    template<typename Self>
+    static T expectImpl(Self&& self, result_detail::ContextArg expectation) {
+        if (CPP_RUST_RESULT_LIKELY(self.storage.isOk())) {
+            return result_detail::forwardLike<Self>(self.storage.value());
+        }
+        fail(LogSeverity::Fatal, LogEvent::Expect, &expectation, &self.storage.error());
+        return result_detail::fallbackValue<T>();
+    }
+
+    template<typename Self, typename U, typename V>
+    static void matchImpl(Self&& self, U& ok, V& err) {
+        if (self.storage.isOk()) ok(result_detail::forwardLike<Self>(self.storage.value()));
+        else err(result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename ReturnType, typename Self, typename Mapper>
+    static Result<ReturnType, E> mapImpl(Self&& self, Mapper& mapper) {
+        if (self.storage.isOk()) {
+            return Result<ReturnType, E>(OkInvokeTag{}, mapper,
+                                         result_detail::forwardLike<Self>(self.storage.value()));
+        }
+        return Result<ReturnType, E>(ErrTag{}, result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename U, typename Self, typename Mapper>
+    static Result<U, E> mapInPlaceImpl(Self&& self, Mapper& mapper) {
+        if (self.storage.isOk()) {
+            return Result<U, E>(OkTag{}, mapper(result_detail::forwardLike<Self>(self.storage.value())));
+        }
+        return Result<U, E>(ErrTag{}, result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename ErrorType, typename Self, typename F>
+    static Result<T, ErrorType> mapErrorImpl(Self&& self, F& mapper) {
+        if (!self.storage.isOk()) {
+            return Result<T, ErrorType>(ErrInvokeTag{}, mapper,
+                                        result_detail::forwardLike<Self>(self.storage.error()));
+        }
+        return Result<T, ErrorType>(OkTag{}, result_detail::forwardLike<Self>(self.storage.value()));
+    }
+
+    template<typename Self, typename F>
+    static auto andThenImpl(Self&& self, F& f)
+        -> decltype(f(result_detail::forwardLike<Self>(self.storage.value()))) {
+        typedef decltype(f(result_detail::forwardLike<Self>(self.storage.value()))) NextResult;
+        if (self.storage.isOk()) return f(result_detail::forwardLike<Self>(self.storage.value()));
+        else return NextResult::Err(result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename Self, typename F>
+    static auto orElseImpl(Self&& self, F& f)
+        -> decltype(f(result_detail::forwardLike<Self>(self.storage.error()))) {
+        typedef decltype(f(result_detail::forwardLike<Self>(self.storage.error()))) NextResult;
+        if (!self.storage.isOk()) return f(result_detail::forwardLike<Self>(self.storage.error()));
+        else return NextResult::Ok(result_detail::forwardLike<Self>(self.storage.value()));
+    }
+};
+
+// static members
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+template<typename T, typename E>
+result_detail::HookOverride Result<T, E>::hooks(nullptr);
+#endif
+
+// -----------------------------------
+// Specialization Result<void, E>
+// -----------------------------------
+template <typename E>
+class Result<void, E> {
+    typedef result_detail::OkTag OkTag;
+    typedef result_detail::ErrTag ErrTag;
+
+    // success holds an empty Unit, so Ok never constructs an E and the
+    // discriminant can share a NicheTraits<E> sentinel
+    result_detail::ResultStorage<result_detail::Unit, E> storage;
+
+    explicit Result(OkTag) : storage(OkTag{}) { CPP_RUST_RESULT_COUNT(Result, ResultMetric::Ok); }
+    template <typename... Args>
+    explicit Result(ErrTag, Args&&... args) : storage(ErrTag{}, std::forward<Args>(args)...) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+
+    template <typename, typename> friend class Result;
+    friend struct result_detail::TryAccess;
+
+    typedef result_detail::IsDynamicPolicy<E> DynamicHooks;
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    typedef result_detail::LogHook LogHook;
+    typedef result_detail::RecordHook RecordHook;
+    typedef result_detail::TerminateHook TerminateHook;
+    static result_detail::HookOverride hooks;   // opt-in per-instantiation override
+    static result_detail::HookOverride* instanceHooks() { return &hooks; }
+#else
+    static result_detail::HookOverride* instanceHooks() { return nullptr; }
+#endif
+
+    // everything past the check lives in result_detail::fail
+    static void fail(LogSeverity severity, LogEvent event,
+                     const result_detail::ContextArg* context, const void* error) {
+        CPP_RUST_RESULT_COUNT_FAILURE(Result, severity, event);
+        result_detail::fail(result_detail::FailurePolicy<E>::handler, instanceHooks(),
+                            severity, event, context, error);
+    }
+
+public:
+    static Result Ok() { return Result(OkTag{}); }
+    static Result Err(const E& err) { return Result(ErrTag{}, err); }
+    static Result Err(E&& err) { return Result(ErrTag{}, std::move(err)); }
+
+    // the error returned by RESULT_TRY from a Result<U, E2>
+    template <typename Ref, typename = typename std::enable_if<std::is_convertible<Ref, E>::value>::type>
+    Result(result_detail::ErrForward<Ref> forward) : storage(ErrTag{}, forward.get()) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+
+    // construct the error directly from constructor arguments
+    template <typename... Args>
+    static Result inPlaceErr(Args&&... args) { return Result(ErrTag{}, std::forward<Args>(args)...); }
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    // per-instantiation override of the ResultHooks registry; safe to call
+    // while other threads are logging through the old hook
+    static void setLogHook(LogHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).log.store(result_detail::adaptLogHook(std::move(hook)));
+    }
+    static void setRecordHook(RecordHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).log.store(std::move(hook));
+    }
+    static void setTerminateHook(TerminateHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).terminate.store(std::move(hook));
+    }
+    static void clearHooks() { result_detail::clearOverride(hooks); }
+#endif
+
+    Result() : storage(OkTag{}) { CPP_RUST_RESULT_COUNT(Result, ResultMetric::Ok); }
+
+    // copy/move/destroy come from the storage and follow E, including
+    // noexcept and triviality
+
+    bool isOk() const { return storage.isOk(); }
+    bool isErr() const { return !storage.isOk(); }
+
+    // checks never consume; unwrapErr moves the error out of a non-const
+    // Result and copies it from a const one; so do the combinators that
+    // hand out the error
+
+    // unwrap: void on success, fatal on err
+    void unwrap(result_detail::ContextArg context = "") const {
+        if (CPP_RUST_RESULT_LIKELY(storage.isOk())) return;
+        fail(LogSeverity::Fatal, LogEvent::Unwrap, &context, &storage.error());
+    }
+
+    E unwrapErr(result_detail::ContextArg context = "") & {
+        return unwrapErrImpl(std::move(*this), context);
+    }
+    E unwrapErr(result_detail::ContextArg context = "") const& {
+        return unwrapErrImpl(*this, context);
+    }
+    E unwrapErr(result_detail::ContextArg context = "") && {
+        return unwrapErrImpl(std::move(*this), context);
+    }
+
+    // unwrapOrLog: no-op for void; but we still log if error
+    void unwrapOrLog(result_detail::ContextArg context = "") const {
+        if (CPP_RUST_RESULT_LIKELY(storage.isOk())) return;
+        fail(LogSeverity::Recoverable, LogEvent::UnwrapOrLog, &context, &storage.error());
+    }
+
+    // unwrapOrElse: accepts fallback callable invoked on Err (executes then returns void)
+    template<typename F>
+    void unwrapOrElse(F fallback) const {
+        if (storage.isOk()) return;
+        fallback();
+    }
+
+    // expect: fatal with message if Err
+    void expect(result_detail::ContextArg expectation) const {
+        if (CPP_RUST_RESULT_LIKELY(storage.isOk())) return;
+        fail(LogSeverity::Fatal, LogEvent::Expect, &expectation, &storage.error());
+    }
+
+    // borrowing views of the error; the Result must outlive the view
+    typedef Result<void, std::reference_wrapper<const E> > ConstView;
+    typedef Result<void, std::reference_wrapper<E> > MutView;
+
+    ConstView asRef() const& {
+        if (storage.isOk()) return ConstView(OkTag{});
+        return ConstView(ErrTag{}, std::cref(storage.error()));
+    }
+    ConstView asRef() const&& = delete;   // would dangle
+
+    MutView asMut() & {
+        if (storage.isOk()) return MutView(OkTag{});
+        return MutView(ErrTag{}, std::ref(storage.error()));
+    }
+
+    // map when T=void: mapper() -> U; returns Result<U,E>, U built in place
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()())>
+    Result<ReturnType, E> map(Mapper mapper) & { return mapImpl<ReturnType>(std::move(*this), mapper); }
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()())>
+    Result<ReturnType, E> map(Mapper mapper) const& { return mapImpl<ReturnType>(*this, mapper); }
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()())>
+    Result<ReturnType, E> map(Mapper mapper) && { return mapImpl<ReturnType>(std::move(*this), mapper); }
+
+    // mapInPlace<U> when T=void: U constructed in place from mapper()
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) & { return mapInPlaceImpl<U>(std::move(*this), mapper); }
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) const& { return mapInPlaceImpl<U>(*this, mapper); }
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) && { return mapInPlaceImpl<U>(std::move(*this), mapper); }
+
+    // andThen when T=void: f() -> Result<U,E>
+    template<typename F>
+    auto andThen(F f) & -> decltype(f()) { return andThenImpl(std::move(*this), f); }
+    template<typename F>
+    auto andThen(F f) const& -> decltype(f()) { return andThenImpl(*this, f); }
+    template<typename F>
+    auto andThen(F f) && -> decltype(f()) { return andThenImpl(std::move(*this), f); }
+
+    // orElse
+    template<typename F>
+    auto orElse(F f) & -> decltype(f(std::declval<E&&>())) { return orElseImpl(std::move(*this), f); }
+    template<typename F>
+    auto orElse(F f) const& -> decltype(f(std::declval<const E&>())) { return orElseImpl(*this, f); }
+    template<typename F>
+    auto orElse(F f) && -> decltype(f(std::declval<E&&>())) { return orElseImpl(std::move(*this), f); }
+
+private:
+    template<typename Self>
+    static E unwrapErrImpl(Self&& self, result_detail::ContextArg context) {
+        if (CPP_RUST_RESULT_LIKELY(!self.storage.isOk())) {
+            return result_detail::forwardLike<Self>(self.storage.error());
+        }
+        fail(LogSeverity::Fatal, LogEvent::UnwrapErr, &context, nullptr);
+        return result_detail::fallbackValue<E>();
+    }
+
+    template<typename ReturnType, typename Self, typename Mapper>
+    static Result<ReturnType, E> mapImpl(Self&& self, Mapper& mapper) {
+        if (self.storage.isOk()) {
+            return Result<ReturnType, E>(result_detail::OkInvokeTag{}, mapper);
+        }
+        return Result<ReturnType, E>(ErrTag{}, result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename U, typename Self, typename Mapper>
+    static Result<U, E> mapInPlaceImpl(Self&& self, Mapper& mapper) {
+        if (self.storage.isOk()) {
+            return Result<U, E>(OkTag{}, mapper());
+        }
+        return Result<U, E>(ErrTag{}, result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename Self, typename F>
+    static auto andThenImpl(Self&& self, F& f) -> decltype(f()) {
+        typedef decltype(f()) NextResult;
+        if (self.storage.isOk()) return f();
+        else return NextResult::Err(result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename Self, typename F>
+    static auto orElseImpl(Self&& self, F& f)
+        -> decltype(f(result_detail::forwardLike<Self>(self.storage.error()))) {
+        typedef decltype(f(result_detail::forwardLike<Self>(self.storage.error()))) NextResult;
+        if (!self.storage.isOk()) return f(result_detail::forwardLike<Self>(self.storage.error()));
+        else return NextResult::Ok();
+    }
+};
+
+// static members for void specialization
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+template<typename E>
+result_detail::HookOverride Result<void, E>::hooks(nullptr);
+#endif
+
+// -----------------------------------
+// Specialization Result<T&, E>
+// -----------------------------------
+// Borrows an existing object: stores a pointer, never copies T. With an
+// empty E the null pointer is the Err state, and with a small E the
+// aligned pointer's low bit is, so both are pointer-sized.
+template <typename T, typename E>
+class Result<T&, E> {
+    typedef result_detail::OkTag OkTag;
+    typedef result_detail::ErrTag ErrTag;
+    typedef result_detail::RefPtr<T> Ref;
+
+    result_detail::ResultStorage<Ref, E> storage;
+
+    explicit Result(OkTag, T& ref) : storage(OkTag{}, Ref{ result_detail::addressOf(ref) }) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Ok);
+    }
+    template <typename... Args>
+    explicit Result(ErrTag, Args&&... args) : storage(ErrTag{}, std::forward<Args>(args)...) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+    template <typename F, typename... Args>
+    Result(result_detail::OkInvokeTag, F&& f, Args&&... args)
+        : storage(OkTag{}, Ref{ result_detail::addressOf(std::forward<F>(f)(std::forward<Args>(args)...)) }) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Ok);
+    }
+    template <typename F, typename... Args>
+    Result(result_detail::ErrInvokeTag, F&& f, Args&&... args)
+        : storage(result_detail::ErrInvokeTag{}, std::forward<F>(f), std::forward<Args>(args)...) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+
+    template <typename, typename> friend class Result;
+    friend struct result_detail::TryAccess;
+
+    typedef result_detail::IsDynamicPolicy<E> DynamicHooks;
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    typedef result_detail::LogHook LogHook;
+    typedef result_detail::RecordHook RecordHook;
+    typedef result_detail::TerminateHook TerminateHook;
+    static result_detail::HookOverride hooks;   // opt-in per-instantiation override
+    static result_detail::HookOverride* instanceHooks() { return &hooks; }
+#else
+    static result_detail::HookOverride* instanceHooks() { return nullptr; }
+#endif
+
+    // everything past the check lives in result_detail::fail
+    static void fail(LogSeverity severity, LogEvent event,
+                     const result_detail::ContextArg* context, const void* error) {
+        CPP_RUST_RESULT_COUNT_FAILURE(Result, severity, event);
+        result_detail::fail(result_detail::FailurePolicy<E>::handler, instanceHooks(),
+                            severity, event, context, error);
+    }
+
+    T& ref() const { return *storage.value().ptr; }
+
+public:
+    static Result Ok(T& ref) { return Result(OkTag{}, ref); }
+    static Result Err(const E& err) { return Result(ErrTag{}, err); }
+    static Result Err(E&& err) { return Result(ErrTag{}, std::move(err)); }
+
+    // the error returned by RESULT_TRY from a Result<U, E2>
+    template <typename Ref, typename = typename std::enable_if<std::is_convertible<Ref, E>::value>::type>
+    Result(result_detail::ErrForward<Ref> forward) : storage(ErrTag{}, forward.get()) {
+        CPP_RUST_RESULT_COUNT(Result, ResultMetric::Err);
+    }
+
+    // construct the error directly from constructor arguments
+    template <typename... Args>
+    static Result inPlaceErr(Args&&... args) { return Result(ErrTag{}, std::forward<Args>(args)...); }
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+    // per-instantiation override of the ResultHooks registry; safe to call
+    // while other threads are logging through the old hook
+    static void setLogHook(LogHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).log.store(result_detail::adaptLogHook(std::move(hook)));
+    }
+    static void setRecordHook(RecordHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).log.store(std::move(hook));
+    }
+    static void setTerminateHook(TerminateHook hook) {
+        static_assert(DynamicHooks::value, "hooks for this error type are fixed by ResultPolicy<E>");
+        result_detail::engage(hooks).terminate.store(std::move(hook));
+    }
+    static void clearHooks() { result_detail::clearOverride(hooks); }
+#endif
+
+    // copy/move/destroy come from the storage and follow E; the referenced
+    // object is never copied
+
+    bool isOk() const { return storage.isOk(); }
+    bool isErr() const { return !storage.isOk(); }
+
+    // reading the reference never consumes; unwrapErr moves the error out
+    // of a non-const Result and copies it from a const one, as do the
+    // combinators; the other accessors copy it from lvalues. There is no
+    // unwrapChecked: a reference has no default to fall back to.
+
+    // unwrap (fatal on Err)
+    T& unwrap(result_detail::ContextArg context = "") const {
+        if (CPP_RUST_RESULT_LIKELY(storage.isOk())) return ref();
+        fail(LogSeverity::Fatal, LogEvent::Unwrap, &context, &storage.error());
+        std::terminate();   // no object to refer to if the hook returns
+    }
+
+    E unwrapErr(result_detail::ContextArg context = "") & {
+        return unwrapErrImpl(std::move(*this), context);
+    }
+    E unwrapErr(result_detail::ContextArg context = "") const& {
+        return unwrapErrImpl(*this, context);
+    }
+    E unwrapErr(result_detail::ContextArg context = "") && {
+        return unwrapErrImpl(std::move(*this), context);
+    }
+
+    // unwrapOrLog: refer to the fallback on Err
+    T& unwrapOrLog(result_detail::ContextArg context, T& fallback) const {
+        if (CPP_RUST_RESULT_LIKELY(storage.isOk())) return ref();
+        fail(LogSeverity::Recoverable, LogEvent::UnwrapOrLog, &context, &storage.error());
+        return fallback;
+    }
+
+    T& expect(result_detail::ContextArg expectation) const {
+        if (CPP_RUST_RESULT_LIKELY(storage.isOk())) return ref();
+        fail(LogSeverity::Fatal, LogEvent::Expect, &expectation, &storage.error());
+        std::terminate();
+    }
+
+    T& unwrapOr(T& fallback) const { return storage.isOk() ? ref() : fallback; }
+
+    // unwrapOrElse: fallback() must return a T& as well
+    template<typename F>
+    T& unwrapOrElse(F fallback) const { return storage.isOk() ? ref() : fallback(); }
+
+    // match (observe)
+    template<typename U, typename V>
+    void match(U ok, V err) & { matchImpl(*this, ok, err); }
+    template<typename U, typename V>
+    void match(U ok, V err) const& { matchImpl(*this, ok, err); }
+    template<typename U, typename V>
+    void match(U ok, V err) && { matchImpl(std::move(*this), ok, err); }
+
+    // map: mapper(T&) -> U; a mapper returning a reference yields another
+    // Result<U&, E>, so projections into the object stay copy-free
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()(std::declval<T&>()))>
+    Result<ReturnType, E> map(Mapper mapper) & { return mapImpl<ReturnType>(std::move(*this), mapper); }
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()(std::declval<T&>()))>
+    Result<ReturnType, E> map(Mapper mapper) const& { return mapImpl<ReturnType>(*this, mapper); }
+    template<typename Mapper,
+             typename ReturnType = decltype(std::declval<Mapper&>()(std::declval<T&>()))>
+    Result<ReturnType, E> map(Mapper mapper) && { return mapImpl<ReturnType>(std::move(*this), mapper); }
+
+    // mapInPlace<U>: U constructed in place from mapper(T&)
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) & { return mapInPlaceImpl<U>(std::move(*this), mapper); }
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) const& { return mapInPlaceImpl<U>(*this, mapper); }
+    template<typename U, typename Mapper>
+    Result<U, E> mapInPlace(Mapper mapper) && { return mapInPlaceImpl<U>(std::move(*this), mapper); }
+
+    // mapError
+    template<typename F,
+             typename ErrorType = decltype(std::declval<F&>()(std::declval<E&&>()))>
+    Result<T&, ErrorType> mapError(F mapper) & { return mapErrorImpl<ErrorType>(std::move(*this), mapper); }
+    template<typename F,
+             typename ErrorType = decltype(std::declval<F&>()(std::declval<const E&>()))>
+    Result<T&, ErrorType> mapError(F mapper) const& { return mapErrorImpl<ErrorType>(*this, mapper); }
+    template<typename F,
+             typename ErrorType = decltype(std::declval<F&>()(std::declval<E&&>()))>
+    Result<T&, ErrorType> mapError(F mapper) && { return mapErrorImpl<ErrorType>(std::move(*this), mapper); }
+
+    // andThen (monadic bind): f(T&) -> Result<U, E>
+    template<typename F>
+    auto andThen(F f) & -> decltype(f(std::declval<T&>())) { return andThenImpl(std::move(*this), f); }
+    template<typename F>
+    auto andThen(F f) const& -> decltype(f(std::declval<T&>())) { return andThenImpl(*this, f); }
+    template<typename F>
+    auto andThen(F f) && -> decltype(f(std::declval<T&>())) { return andThenImpl(std::move(*this), f); }
+
+    // orElse
+    template<typename F>
+    auto orElse(F f) & -> decltype(f(std::declval<E&&>())) { return orElseImpl(std::move(*this), f); }
+    template<typename F>
+    auto orElse(F f) const& -> decltype(f(std::declval<const E&>())) { return orElseImpl(*this, f); }
+    template<typename F>
+    auto orElse(F f) && -> decltype(f(std::declval<E&&>())) { return orElseImpl(std::move(*this), f); }
+
+private:
+    template<typename Self>
+    static E unwrapErrImpl(Self&& self, result_detail::ContextArg context) {
+        if (CPP_RUST_RESULT_LIKELY(!self.storage.isOk())) {
+            return result_detail::forwardLike<Self>(self.storage.error());
+        }
+        fail(LogSeverity::Fatal, LogEvent::UnwrapErr, &context, nullptr);
+        return result_detail::fallbackValue<E>();
+    }
+
+    template<typename Self, typename U, typename V>
+    static void matchImpl(Self&& self, U& ok, V& err) {
+        if (self.storage.isOk()) ok(self.ref());
+        else err(result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename ReturnType, typename Self, typename Mapper>
+    static Result<ReturnType, E> mapImpl(Self&& self, Mapper& mapper) {
+        if (self.storage.isOk()) {
+            return Result<ReturnType, E>(result_detail::OkInvokeTag{}, mapper, self.ref());
+        }
+        return Result<ReturnType, E>(ErrTag{}, result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename U, typename Self, typename Mapper>
+    static Result<U, E> mapInPlaceImpl(Self&& self, Mapper& mapper) {
+        if (self.storage.isOk()) {
+            return Result<U, E>(OkTag{}, mapper(self.ref()));
+        }
+        return Result<U, E>(ErrTag{}, result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename ErrorType, typename Self, typename F>
+    static Result<T&, ErrorType> mapErrorImpl(Self&& self, F& mapper) {
+        if (!self.storage.isOk()) {
+            return Result<T&, ErrorType>(result_detail::ErrInvokeTag{}, mapper,
+                                         result_detail::forwardLike<Self>(self.storage.error()));
+        }
+        return Result<T&, ErrorType>(OkTag{}, self.ref());
+    }
+
+    template<typename Self, typename F>
+    static auto andThenImpl(Self&& self, F& f) -> decltype(f(self.ref())) {
+        typedef decltype(f(self.ref())) NextResult;
+        if (self.storage.isOk()) return f(self.ref());
+        else return NextResult::Err(result_detail::forwardLike<Self>(self.storage.error()));
+    }
+
+    template<typename Self, typename F>
+    static auto orElseImpl(Self&& self, F& f)
+        -> decltype(f(result_detail::forwardLike<Self>(self.storage.error()))) {
+        typedef decltype(f(result_detail::forwardLike<Self>(self.storage.error()))) NextResult;
+        if (!self.storage.isOk()) return f(result_detail::forwardLike<Self>(self.storage.error()));
+        else return NextResult::Ok(self.ref());
+    }
+};
+
+// static members for reference specialization
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+template<typename T, typename E>
+result_detail::HookOverride Result<T&, E>::hooks(nullptr);
+#endif
+
+// ---------------------------
+// C++20 coroutines
+// ---------------------------
+// A function returning Result<T, E> may be a coroutine: co_await on a
+// Result yields its payload or returns its error from the coroutine, and
+// co_return takes a payload or a whole Result.
+//
+//     Result<double, std::string> computeValue(const std::string& path) {
+//         std::string content = co_await readFile(path);
+//         std::string processed = co_await parseInput(content);
+//         co_return static_cast<double>(processed.size());
+//     }
+//
+// The coroutine never really suspends: it runs to completion inside the
+// call, and on Err the awaiter writes the error and destroys the frame.
+// Relies on the return object being converted once the body has finished
+// (GCC, Clang 17+ and MSVC do this when get_return_object()'s type differs
+// from the return type).
+#if defined(CPP_RUST_RESULT_COROUTINES)
+namespace result_detail {
+
+// Frames live only for the duration of the call and are freed on the
+// thread that allocated them, so a small per-thread cache per size class
+// makes the frame allocation a list pop in steady state (GCC does not
+// elide coroutine frames). The lists are trivially destructible so the hot
+// path has no TLS guard; a one-off reaper frees them at thread exit.
+class FrameCache {
+    static const std::size_t granule = 64;
+    static const std::size_t classes = 16;
+    static const unsigned depth = 8;
+
+    struct Node {
+        Node* next;
+    };
+
+    struct Lists {
+        Node* heads[classes];
+        unsigned counts[classes];
+        bool reaped;
+    };
+
+    struct Reaper {
+        ~Reaper() {
+            Lists& cache = lists();
+            for (std::size_t i = 0; i < classes; ++i) {
+                while (Node* node = cache.heads[i]) {
+                    cache.heads[i] = node->next;
+                    ::operator delete(node);
+                }
+                cache.counts[i] = depth;   // frames freed after this go back to the heap
+            }
+        }
+    };
+
+    static Lists& lists() {
+        static thread_local Lists cache;
+        return cache;
+    }
+
+public:
+    static void* allocate(std::size_t size) {
+        std::size_t bucket = (size + granule - 1) / granule - 1;
+        if (bucket >= classes) return ::operator new(size);
+        Lists& cache = lists();
+        if (Node* node = cache.heads[bucket]) {
+            cache.heads[bucket] = node->next;
+            --cache.counts[bucket];
+            return node;
+        }
+        return ::operator new((bucket + 1) * granule);
+    }
+
+    static void deallocate(void* frame, std::size_t size) {
+        std::size_t bucket = (size + granule - 1) / granule - 1;
+        if (bucket < classes) {
+            Lists& cache = lists();
+            if (cache.counts[bucket] < depth) {
+                if (!cache.reaped) {
+                    cache.reaped = true;
+                    static thread_local Reaper reaper;
+                    (void)reaper;
+                }
+                Node* node = static_cast<Node*>(frame);
+                node->next = cache.heads[bucket];
+                cache.heads[bucket] = node;
+                ++cache.counts[bucket];
+                return;
+            }
+        }
+        ::operator delete(frame);
+    }
+};
+
+template <typename T, typename E>
+class CoroutineReturn;
+
+template <typename T, typename E>
+struct CoroutinePromiseBase {
+    CoroutineReturn<T, E>* out = nullptr;
+
+    CoroutineReturn<T, E> get_return_object() { return CoroutineReturn<T, E>(*this); }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void unhandled_exception() {
+#if defined(__cpp_exceptions)
+        throw;
+#else
+        std::terminate();
+#endif
+    }
+
+    static void* operator new(std::size_t size) { return FrameCache::allocate(size); }
+    static void operator delete(void* frame, std::size_t size) { FrameCache::deallocate(frame, size); }
+
+    // co_await on any Result whose error converts to E
+    template <typename R>
+    struct Awaiter {
+        R&& awaited;
+
+        bool await_ready() const noexcept { return TryAccess::ok(awaited); }
+        decltype(TryAccess::value(std::declval<R&&>())) await_resume() {
+            return TryAccess::value(std::forward<R>(awaited));
+        }
+        template <typename Promise>
+        void await_suspend(std::coroutine_handle<Promise> self) {
+            self.promise().out->set(TryAccess::error(std::forward<R>(awaited)));
+            self.destroy();
+        }
+    };
+
+    template <typename U, typename E2>
+    Awaiter<Result<U, E2> > await_transform(Result<U, E2>&& awaited) { return { std::move(awaited) }; }
+    template <typename U, typename E2>
+    Awaiter<const Result<U, E2>&> await_transform(const Result<U, E2>& awaited) { return { awaited }; }
+};
+
+template <typename T, typename E>
+struct CoroutinePromise : CoroutinePromiseBase<T, E> {
+    void return_value(Result<T, E>&& result) { this->out->set(std::move(result)); }
+    void return_value(const Result<T, E>& result) { this->out->set(result); }
+    template <typename U, typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<U>::type, Result<T, E> >::value>::type>
+    void return_value(U&& value) { this->out->setOk(std::forward<U>(value)); }
+};
+
+template <typename E>
+struct CoroutinePromise<void, E> : CoroutinePromiseBase<void, E> {
+    void return_void() { this->out->setOk(); }
+};
+
+// What get_return_object() hands the caller: holds the Result until the
+// body has finished, then converts into the coroutine's return value.
+// This relies on the conversion being delayed until the body returns
+// (GCC always does, Clang since 17), see the check at the top.
+template <typename T, typename E>
+class CoroutineReturn {
+    typedef Result<T, E> Stored;
+
+public:
+    explicit CoroutineReturn(CoroutinePromiseBase<T, E>& promise) : promise(&promise) { promise.out = this; }
+    CoroutineReturn(CoroutineReturn&& other) : promise(other.promise), filled(other.filled) {
+        if (filled) new (&slot) Result<T, E>(std::move(other.result()));
+        if (promise) promise->out = this;
+    }
+    CoroutineReturn(const CoroutineReturn&) = delete;
+    CoroutineReturn& operator=(const CoroutineReturn&) = delete;
+
+    ~CoroutineReturn() {
+        if (filled) result().~Stored();
+    }
+
+    template <typename R>
+    void set(R&& value) {
+        new (&slot) Result<T, E>(std::forward<R>(value));
+        filled = true;
+        promise = nullptr;   // the frame is about to go away
+    }
+
+    // the prvalue is built directly in the slot
+    template <typename... Args>
+    void setOk(Args&&... args) {
+        new (&slot) Result<T, E>(Result<T, E>::Ok(std::forward<Args>(args)...));
+        filled = true;
+        promise = nullptr;
+    }
+
+    operator Result<T, E>() {
+        if (!filled) std::terminate();   // converted before the body ran
+        return std::move(result());
+    }
+
+private:
+    Result<T, E>& result() { return *reinterpret_cast<Result<T, E>*>(&slot); }
+
+    CoroutinePromiseBase<T, E>* promise;
+    bool filled = false;
+    alignas(Result<T, E>) unsigned char slot[sizeof(Result<T, E>)];
+};
+
+} // namespace result_detail
+
+namespace std {
+template <typename T, typename E, typename... Args>
+struct coroutine_traits<Result<T, E>, Args...> {
+    typedef result_detail::CoroutinePromise<T, E> promise_type;
+};
+} // namespace std
+#endif
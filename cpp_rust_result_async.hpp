@@ -0,0 +1,565 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <vector>
+
+// ---------------------------
+// Executors
+// ---------------------------
+
+// Where a continuation runs. The default runs it on the thread that
+// completes the previous stage; any object with submit(std::function<void()>)
+// (WorkStealingPool, for one) can be passed instead and must outlive the
+// continuations posted to it.
+class AsyncExecutor {
+public:
+    typedef std::function<void()> Task;
+
+    AsyncExecutor() : context(nullptr), post(nullptr) {}
+
+    template <typename Executor, typename = typename std::enable_if<
+                  !std::is_same<typename std::decay<Executor>::type, AsyncExecutor>::value>::type>
+    AsyncExecutor(Executor& executor) : context(&executor), post(&postTo<Executor>) {}
+
+    bool isInline() const { return post == nullptr; }
+
+    void submit(Task task) const {
+        if (post) post(context, std::move(task));
+        else task();
+    }
+
+private:
+    template <typename Executor>
+    static void postTo(void* context, Task&& task) { static_cast<Executor*>(context)->submit(std::move(task)); }
+
+    void* context;
+    void (*post)(void*, Task&&);
+};
+
+template <typename T, typename E>
+class AsyncResult;
+
+// ---------------------------
+// Shared state
+// ---------------------------
+namespace result_detail {
+
+template <typename T, typename E>
+class AsyncState;
+
+// the single consumer of a state, told once the Result is in place
+template <typename T, typename E>
+class AsyncListener {
+public:
+    virtual void ready(AsyncState<T, E>& state) = 0;
+
+protected:
+    ~AsyncListener() {}
+};
+
+// intrusive count: a stage is one allocation, with no separate control block
+class AsyncStateBase {
+public:
+    explicit AsyncStateBase(int refs) : refs(refs) {}
+
+    AsyncStateBase(const AsyncStateBase&) = delete;
+    AsyncStateBase& operator=(const AsyncStateBase&) = delete;
+
+    void release() {
+        if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+    }
+
+protected:
+    virtual ~AsyncStateBase() {}
+
+private:
+    std::atomic<int> refs;
+};
+
+// The Result slot of one stage, written once by its producer. References:
+// the AsyncResult handle and the producer hold one each.
+template <typename T, typename E>
+class AsyncState : public AsyncStateBase {
+    static_assert(!std::is_reference<T>::value, "AsyncResult stores its payload");
+    typedef Result<T, E> Stored;
+
+public:
+    explicit AsyncState(int refs = 2) : AsyncStateBase(refs), done(false), listener(nullptr), waiters(0) {}
+
+    ~AsyncState() {
+        if (done.load(std::memory_order_relaxed)) result().~Stored();
+    }
+
+    template <typename R>
+    void complete(R&& value) {
+        new (&slot) Result<T, E>(std::forward<R>(value));
+        AsyncListener<T, E>* notify;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            done.store(true, std::memory_order_release);
+            notify = listener;
+            if (waiters) wake.notify_all();
+        }
+        if (notify) notify->ready(*this);
+    }
+
+    // called at most once; runs the listener now when already complete
+    void listen(AsyncListener<T, E>* consumer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!done.load(std::memory_order_relaxed)) {
+                listener = consumer;
+                return;
+            }
+        }
+        consumer->ready(*this);
+    }
+
+    bool isReady() const { return done.load(std::memory_order_acquire); }
+
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        ++waiters;
+        wake.wait(lock, [&] { return done.load(std::memory_order_relaxed); });
+        --waiters;
+    }
+
+    Result<T, E>& result() { return *reinterpret_cast<Result<T, E>*>(&slot); }
+
+private:
+    typename std::aligned_storage<sizeof(Result<T, E>), alignof(Result<T, E>)>::type slot;
+    std::atomic<bool> done;
+    AsyncListener<T, E>* listener;
+    int waiters;
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+// what a continuation receives: the payload, or nothing for Result<void, E>
+template <typename T>
+struct AsyncArg {
+    typedef T Stored;
+
+    template <typename F>
+    static auto call(F& f, T&& value) -> decltype(f(std::move(value))) { return f(std::move(value)); }
+
+    template <typename Next>
+    static Next ok(T&& value) { return Next::Ok(std::move(value)); }
+};
+
+template <>
+struct AsyncArg<void> {
+    typedef Unit Stored;
+
+    template <typename F>
+    static auto call(F& f, Unit&&) -> decltype(f()) { return f(); }
+
+    template <typename Next>
+    static Next ok(Unit&&) { return Next::Ok(); }
+};
+
+template <typename Next, typename Arg, typename F>
+Next okFromCall(F& f, typename Arg::Stored&& value, std::false_type) {
+    return Next::Ok(Arg::call(f, std::move(value)));
+}
+
+template <typename Next, typename Arg, typename F>
+Next okFromCall(F& f, typename Arg::Stored&& value, std::true_type) {
+    Arg::call(f, std::move(value));
+    return Next::Ok();
+}
+
+// a continuation returns either a Result or another AsyncResult
+template <typename Next>
+struct AsyncNext;
+
+template <typename U, typename E>
+struct AsyncNext<Result<U, E> > {
+    typedef U Value;
+    typedef E Error;
+    typedef std::false_type IsAsync;
+};
+
+template <typename U, typename E>
+struct AsyncNext<AsyncResult<U, E> > {
+    typedef U Value;
+    typedef E Error;
+    typedef std::true_type IsAsync;
+};
+
+// Each step maps the finished Result of the previous stage to Next
+template <typename T, typename E, typename F>
+struct MapStep {
+    typedef AsyncArg<T> Arg;
+    typedef typename std::decay<decltype(Arg::call(std::declval<F&>(),
+                                                   std::declval<typename Arg::Stored&&>()))>::type U;
+    typedef Result<U, E> Next;
+
+    static Next apply(F& f, Result<T, E>&& r) {
+        if (!TryAccess::ok(r)) return Next::Err(TryAccess::error(std::move(r)).get());
+        return okFromCall<Next, Arg>(f, TryAccess::value(std::move(r)), std::is_void<U>());
+    }
+};
+
+template <typename T, typename E, typename F>
+struct AndThenStep {
+    typedef AsyncArg<T> Arg;
+    typedef typename std::decay<decltype(Arg::call(std::declval<F&>(),
+                                                   std::declval<typename Arg::Stored&&>()))>::type Next;
+
+    static Next apply(F& f, Result<T, E>&& r) {
+        if (!TryAccess::ok(r)) return Next::Err(TryAccess::error(std::move(r)).get());
+        return Arg::call(f, TryAccess::value(std::move(r)));
+    }
+};
+
+template <typename T, typename E, typename F>
+struct OrElseStep {
+    typedef typename std::decay<decltype(std::declval<F&>()(std::declval<E&&>()))>::type Next;
+
+    static Next apply(F& f, Result<T, E>&& r) {
+        if (TryAccess::ok(r)) return AsyncArg<T>::template ok<Next>(TryAccess::value(std::move(r)));
+        return f(TryAccess::error(std::move(r)).get());
+    }
+};
+
+template <typename Step>
+struct StepTypes {
+    typedef AsyncNext<typename Step::Next> Out;
+    typedef AsyncState<typename Out::Value, typename Out::Error> Target;
+    typedef AsyncResult<typename Out::Value, typename Out::Error> Async;
+};
+
+// A continuation and the state it produces in one allocation: it listens on
+// the source, runs Step on the executor, and completes itself. When the
+// step returns an AsyncResult the stage forwards that one's Result.
+template <typename T, typename E, typename Step, typename F>
+class AsyncStage : public StepTypes<Step>::Target, private AsyncListener<T, E> {
+    typedef typename StepTypes<Step>::Out Out;
+    typedef typename StepTypes<Step>::Target Target;
+
+    struct Forward : AsyncListener<typename Out::Value, typename Out::Error> {
+        AsyncStage* owner;
+
+        void ready(Target& inner) override {
+            owner->finish(std::move(inner.result()));
+            inner.release();
+        }
+    };
+
+public:
+    AsyncStage(AsyncState<T, E>* source, F&& f, AsyncExecutor executor)
+        : f(std::move(f)), executor(executor), source(source) {}
+
+    void start() { source->listen(this); }
+
+private:
+    void ready(AsyncState<T, E>&) override {
+        if (executor.isInline()) run();
+        else executor.submit([this] { run(); });
+    }
+
+    void run() {
+        typename Step::Next next = Step::apply(f, std::move(source->result()));
+        source->release();
+        deliver(std::move(next), typename Out::IsAsync());
+    }
+
+    void deliver(typename Step::Next&& next, std::false_type) { finish(std::move(next)); }
+
+    void deliver(typename Step::Next&& next, std::true_type) {
+        forward.owner = this;
+        next.detach()->listen(&forward);
+    }
+
+    void finish(Result<typename Out::Value, typename Out::Error>&& value) {
+        this->complete(std::move(value));
+        this->release();
+    }
+
+    F f;
+    AsyncExecutor executor;
+    AsyncState<T, E>* source;
+    Forward forward;
+};
+
+// runAsync: the state doubles as the task's capture
+template <typename F>
+class AsyncCall : public AsyncState<typename AsyncNext<typename std::decay<decltype(std::declval<F&>()())>::type>::Value,
+                                    typename AsyncNext<typename std::decay<decltype(std::declval<F&>()())>::type>::Error> {
+    typedef AsyncNext<typename std::decay<decltype(std::declval<F&>()())>::type> Out;
+
+public:
+    typedef AsyncResult<typename Out::Value, typename Out::Error> Async;
+
+    static Async spawn(F&& f, AsyncExecutor executor) {
+        AsyncCall* call = new AsyncCall(std::move(f));
+        Async out(call);
+        executor.submit([call] { call->run(); });
+        return out;
+    }
+
+private:
+    explicit AsyncCall(F&& f) : f(std::move(f)) {}
+
+    void run() {
+        this->complete(f());
+        this->release();
+    }
+
+    F f;
+};
+
+// whenAll: one listener per input, completes on the first Err or once all are in
+template <typename T, typename E>
+class AsyncJoin : public AsyncState<std::vector<T>, E> {
+    struct Input : AsyncListener<T, E> {
+        AsyncJoin* join;
+        AsyncState<T, E>* state;
+
+        void ready(AsyncState<T, E>&) override { join->arrived(*this); }
+    };
+
+public:
+    static AsyncResult<std::vector<T>, E> start(std::vector<AsyncResult<T, E> >& sources) {
+        AsyncJoin* join = new AsyncJoin(sources);
+        AsyncResult<std::vector<T>, E> out(join);
+        if (join->inputs.empty()) {
+            join->complete(Result<std::vector<T>, E>::Ok(std::vector<T>()));
+            join->release();
+            return out;
+        }
+        for (std::size_t i = 0; i < join->inputs.size(); ++i) {
+            join->inputs[i].state->listen(&join->inputs[i]);
+        }
+        return out;
+    }
+
+private:
+    explicit AsyncJoin(std::vector<AsyncResult<T, E> >& sources)
+        : inputs(sources.size()), remaining(sources.size()), failed(false) {
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            inputs[i].join = this;
+            inputs[i].state = sources[i].detach();
+        }
+    }
+
+    void arrived(Input& input) {
+        Result<T, E>& r = input.state->result();
+        if (!TryAccess::ok(r) && !failed.exchange(true, std::memory_order_acq_rel)) {
+            this->complete(Result<std::vector<T>, E>::Err(TryAccess::error(std::move(r)).get()));
+        }
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+        if (!failed.load(std::memory_order_relaxed)) {
+            std::vector<T> values;
+            values.reserve(inputs.size());
+            for (std::size_t i = 0; i < inputs.size(); ++i) {
+                values.emplace_back(TryAccess::value(std::move(inputs[i].state->result())));
+            }
+            this->complete(Result<std::vector<T>, E>::Ok(std::move(values)));
+        }
+        for (std::size_t i = 0; i < inputs.size(); ++i) inputs[i].state->release();
+        this->release();
+    }
+
+    std::vector<Input> inputs;
+    std::atomic<std::size_t> remaining;
+    std::atomic<bool> failed;
+};
+
+} // namespace result_detail
+
+// ---------------------------
+// AsyncResult<T,E>
+// ---------------------------
+
+// A Result that is not there yet. map/andThen/orElse register a
+// continuation instead of waiting: it runs on the executor once the
+// previous stage completes, and each stage is a single allocation holding
+// the continuation and its output slot. Handles are move-only and every
+// combinator consumes the handle it is called on.
+//
+//     runAsync([=] { return readFile(path); }, pool)
+//         .andThen([](std::string text) { return parseInput(text); }, pool)
+//         .map([](const std::string& s) { return s.size(); })
+//         .get();   // blocks only here
+template <typename T, typename E>
+class AsyncResult {
+    typedef result_detail::AsyncState<T, E> State;
+
+    State* state;
+
+    explicit AsyncResult(State* state) : state(state) {}
+
+    // hands the reference over to a stage or join
+    State* detach() {
+        State* taken = state;
+        state = nullptr;
+        return taken;
+    }
+
+    template <typename Step, typename F>
+    typename result_detail::StepTypes<Step>::Async then(F&& f, AsyncExecutor executor) {
+        auto stage = new result_detail::AsyncStage<T, E, Step, F>(detach(), std::move(f), executor);
+        stage->start();
+        return typename result_detail::StepTypes<Step>::Async(stage);
+    }
+
+    template <typename, typename> friend class AsyncResult;
+    template <typename, typename> friend class AsyncPromise;
+    template <typename, typename, typename, typename> friend class result_detail::AsyncStage;
+    template <typename, typename> friend class result_detail::AsyncJoin;
+    template <typename> friend class result_detail::AsyncCall;
+
+public:
+    // already complete
+    static AsyncResult ready(Result<T, E> result) {
+        State* done = new State(1);
+        done->complete(std::move(result));
+        return AsyncResult(done);
+    }
+    template <typename... Args>
+    static AsyncResult Ok(Args&&... args) { return ready(Result<T, E>::Ok(std::forward<Args>(args)...)); }
+    template <typename... Args>
+    static AsyncResult Err(Args&&... args) { return ready(Result<T, E>::Err(std::forward<Args>(args)...)); }
+
+    AsyncResult(AsyncResult&& other) noexcept : state(other.detach()) {}
+    AsyncResult& operator=(AsyncResult&& other) noexcept {
+        if (this != &other) {
+            if (state) state->release();
+            state = other.detach();
+        }
+        return *this;
+    }
+    AsyncResult(const AsyncResult&) = delete;
+    AsyncResult& operator=(const AsyncResult&) = delete;
+
+    ~AsyncResult() {
+        if (state) state->release();
+    }
+
+    // false once consumed by a combinator, get() or a move
+    bool valid() const { return state != nullptr; }
+    bool isReady() const { return state->isReady(); }
+    void wait() const { state->wait(); }
+
+    // blocks the calling thread; for the edge of the program, not for chains
+    Result<T, E> get() && {
+        state->wait();
+        Result<T, E> result(std::move(state->result()));
+        detach()->release();
+        return result;
+    }
+
+    // f(T) -> U, gives AsyncResult<U, E>
+    template <typename F>
+    typename result_detail::StepTypes<result_detail::MapStep<T, E, F> >::Async
+    map(F f, AsyncExecutor executor = AsyncExecutor()) && {
+        return then<result_detail::MapStep<T, E, F> >(std::move(f), executor);
+    }
+
+    // f(T) -> Result<U, E> or AsyncResult<U, E>
+    template <typename F>
+    typename result_detail::StepTypes<result_detail::AndThenStep<T, E, F> >::Async
+    andThen(F f, AsyncExecutor executor = AsyncExecutor()) && {
+        return then<result_detail::AndThenStep<T, E, F> >(std::move(f), executor);
+    }
+
+    // f(E) -> Result<T, E2> or AsyncResult<T, E2>
+    template <typename F>
+    typename result_detail::StepTypes<result_detail::OrElseStep<T, E, F> >::Async
+    orElse(F f, AsyncExecutor executor = AsyncExecutor()) && {
+        return then<result_detail::OrElseStep<T, E, F> >(std::move(f), executor);
+    }
+};
+
+// The errors an AsyncPromise reports through its future. Error types
+// constructible from a message get one, others are value-initialised;
+// specialise for an E where neither means "no result":
+//
+//     template <> struct AsyncPromiseError<ErrorCode> {
+//         static ErrorCode broken() { return ErrorCode::Cancelled; }
+//         static ErrorCode alreadyRetrieved() { return ErrorCode::Internal; }
+//     };
+template <typename E>
+struct AsyncPromiseError {
+    static E broken() { return make("Broken promise: destroyed without a result", FromMessage()); }
+    static E alreadyRetrieved() { return make("Promise future already retrieved", FromMessage()); }
+
+private:
+    typedef std::is_constructible<E, const char*> FromMessage;
+
+    static E make(const char* message, std::true_type) { return E(message); }
+    static E make(const char*, std::false_type) { return E(); }
+};
+
+// The producer side, for callback-based I/O: set the Result once, before
+// or after the future is taken; later calls to set are ignored. A promise
+// destroyed without being set completes its future with
+// AsyncPromiseError<E>::broken(), and a second future() is an Err handle
+// holding AsyncPromiseError<E>::alreadyRetrieved().
+template <typename T, typename E>
+class AsyncPromise {
+    result_detail::AsyncState<T, E>* state;   // null once set and retrieved
+    bool retrieved;
+    bool satisfied;
+
+public:
+    AsyncPromise() : state(new result_detail::AsyncState<T, E>(2)), retrieved(false), satisfied(false) {}
+    AsyncPromise(AsyncPromise&& other) noexcept
+        : state(other.state), retrieved(other.retrieved), satisfied(other.satisfied) {
+        other.state = nullptr;
+    }
+    AsyncPromise(const AsyncPromise&) = delete;
+    AsyncPromise& operator=(const AsyncPromise&) = delete;
+    AsyncPromise& operator=(AsyncPromise&&) = delete;
+
+    ~AsyncPromise() {
+        if (!state) return;
+        if (!satisfied) state->complete(Result<T, E>::Err(AsyncPromiseError<E>::broken()));
+        if (!retrieved) state->release();   // the handle's reference
+        state->release();
+    }
+
+    AsyncResult<T, E> future() {
+        if (retrieved || !state) return AsyncResult<T, E>::Err(AsyncPromiseError<E>::alreadyRetrieved());
+        retrieved = true;
+        AsyncResult<T, E> out(state);
+        if (satisfied) {
+            state->release();   // already set: the producer is done with it
+            state = nullptr;
+        }
+        return out;
+    }
+
+    void set(Result<T, E> result) {
+        if (satisfied) return;
+        satisfied = true;
+        state->complete(std::move(result));
+        if (!retrieved) return;   // keep the state for future()
+        state->release();
+        state = nullptr;
+    }
+    template <typename... Args>
+    void setOk(Args&&... args) { set(Result<T, E>::Ok(std::forward<Args>(args)...)); }
+    template <typename... Args>
+    void setErr(Args&&... args) { set(Result<T, E>::Err(std::forward<Args>(args)...)); }
+};
+
+// f() -> Result<T, E>, run on the executor
+template <typename F>
+typename result_detail::AsyncCall<F>::Async runAsync(F f, AsyncExecutor executor) {
+    return result_detail::AsyncCall<F>::spawn(std::move(f), executor);
+}
+
+// Joins the inputs into one AsyncResult<std::vector<T>, E>: the payloads in
+// input order, or the first Err to complete.
+template <typename T, typename E>
+AsyncResult<std::vector<T>, E> whenAll(std::vector<AsyncResult<T, E> > inputs) {
+    return result_detail::AsyncJoin<T, E>::start(inputs);
+}
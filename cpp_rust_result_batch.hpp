@@ -0,0 +1,322 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// ---------------------------
+// Columnar batches
+// ---------------------------
+//
+// ResultBatch<T, E> holds n results as columns: the values in one 64-byte
+// aligned array, a bitmask with bit i set when element i is Ok, and the
+// errors in a side table of (index, E) pairs, which stays small when Errs
+// are rare. A std::vector<Result<T, E>> interleaves each value with its
+// tag (and a std::string error with it), so no loop over it vectorises;
+// the batch operations below walk the columns 64 lanes (one mask word) at
+// a time in loops the compiler vectorises:
+//
+//     auto quotients = ResultBatch<double, std::string>::tabulate(n,
+//         [&](std::size_t i) { return a[i] / b[i]; },
+//         [&](std::size_t i) { return b[i] != 0.0; },
+//         [](std::size_t) { return std::string("Division by zero"); });
+//
+//     auto scaled = quotients.map([](double q) { return q * 2.0 + 1.0; });
+//     std::size_t failed = scaled.countErr();
+//     std::vector<double> ok = scaled.filterOk();
+//
+// Like the columnar formats it borrows from, map computes every lane,
+// Err lanes included, so that the loop has no branch: f must be safe to
+// call on any T (pure arithmetic is; an integer division is not). Err
+// lanes hold T() after pushErr, and whatever tabulate computed otherwise.
+namespace result_detail {
+
+inline std::size_t popcount64(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::size_t>(__builtin_popcountll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<std::size_t>(__popcnt64(word));
+#else
+    word = word - ((word >> 1) & 0x5555555555555555ull);
+    word = (word & 0x3333333333333333ull) + ((word >> 2) & 0x3333333333333333ull);
+    word = (word + (word >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return static_cast<std::size_t>((word * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+inline unsigned lowestBit(std::uint64_t word) {
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<unsigned>(__builtin_ctzll(word));
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return static_cast<unsigned>(index);
+#else
+    unsigned index = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+// Writes lane(0..lanes) to out. A full block goes through a local array
+// first: 64 iterations into storage nothing else can alias are what GCC's
+// -O2 vectoriser accepts (no runtime alias check, no epilogue).
+template <typename T, typename Lane>
+void fillBlock(T* out, std::size_t lanes, const Lane& lane) {
+    if (lanes == 64) {
+        T block[64];
+        for (std::size_t j = 0; j < 64; ++j) block[j] = lane(j);
+        std::memcpy(out, block, sizeof block);
+    } else {
+        for (std::size_t j = 0; j < lanes; ++j) out[j] = lane(j);
+    }
+}
+
+// A growable array of trivially copyable T starting on a cache line.
+template <typename T>
+class AlignedColumn {
+public:
+    static const std::size_t alignment = 64;
+
+    AlignedColumn() : raw(), first(nullptr), count(0), room(0) {}
+
+    AlignedColumn(AlignedColumn&& other) noexcept
+        : raw(std::move(other.raw)), first(other.first), count(other.count), room(other.room) {
+        other.first = nullptr;
+        other.count = other.room = 0;
+    }
+
+    AlignedColumn& operator=(AlignedColumn&& other) noexcept {
+        raw = std::move(other.raw);
+        first = other.first;
+        count = other.count;
+        room = other.room;
+        other.first = nullptr;
+        other.count = other.room = 0;
+        return *this;
+    }
+
+    AlignedColumn(const AlignedColumn& other) : raw(), first(nullptr), count(0), room(0) {
+        resize(other.count);
+        if (count) std::memcpy(first, other.first, count * sizeof(T));
+    }
+
+    AlignedColumn& operator=(const AlignedColumn& other) {
+        if (this != &other) {
+            AlignedColumn copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    T* data() { return first; }
+    const T* data() const { return first; }
+    std::size_t size() const { return count; }
+
+    void reserve(std::size_t n) {
+        if (n <= room) return;
+        std::unique_ptr<char[]> bigger(new char[n * sizeof(T) + alignment - 1]);
+        T* start = reinterpret_cast<T*>(
+            (reinterpret_cast<std::uintptr_t>(bigger.get()) + alignment - 1) & ~std::uintptr_t(alignment - 1));
+        if (count) std::memcpy(start, first, count * sizeof(T));
+        raw = std::move(bigger);
+        first = start;
+        room = n;
+    }
+
+    // new elements are uninitialised; callers write every one
+    void resize(std::size_t n) {
+        reserve(n);
+        count = n;
+    }
+
+    void push(const T& value) {
+        if (count == room) reserve(room ? room * 2 : 16);
+        first[count++] = value;
+    }
+
+private:
+    std::unique_ptr<char[]> raw;
+    T* first;
+    std::size_t count;
+    std::size_t room;
+};
+
+} // namespace result_detail
+
+template <typename T, typename E>
+class ResultBatch {
+    static_assert(result_detail::IsTriviallyCopyable<T>::value, "ResultBatch stores values as a raw column");
+
+public:
+    typedef std::pair<std::size_t, E> IndexedError;
+
+    ResultBatch() : count(0) {}
+
+    // Element i is value(i) when valid(i), else Err(error(i)). value runs
+    // for every lane in one loop and valid in another, so both should be
+    // cheap, branch-free and safe for every i.
+    template <typename Value, typename Valid, typename MakeError>
+    static ResultBatch tabulate(std::size_t n, Value value, Valid valid, MakeError error) {
+        ResultBatch out;
+        out.count = n;
+        out.values.resize(n);
+        out.mask.assign(words(n), 0);
+        T* column = out.values.data();
+        for (std::size_t w = 0; w < out.mask.size(); ++w) {
+            std::size_t base = w * 64;
+            result_detail::fillBlock(column + base, std::min<std::size_t>(64, n - base),
+                                     [&](std::size_t j) { return value(base + j); });
+            std::uint64_t bits = 0;
+            for (std::size_t j = 0, lanes = std::min<std::size_t>(64, n - base); j < lanes; ++j) {
+                bits |= static_cast<std::uint64_t>(valid(base + j) ? 1 : 0) << j;
+            }
+            out.mask[w] = bits;
+        }
+        for (std::size_t w = 0; w < out.mask.size(); ++w) {
+            std::uint64_t missing = ~out.mask[w] & out.liveBits(w);
+            while (missing) {
+                std::size_t i = w * 64 + result_detail::lowestBit(missing);
+                out.errors.push_back(IndexedError(i, error(i)));
+                missing &= missing - 1;
+            }
+        }
+        return out;
+    }
+
+    // the columns of a range of Result<T, E>
+    template <typename It>
+    static ResultBatch from(It first, It last) {
+        ResultBatch out;
+        for (; first != last; ++first) out.push(*first);
+        return out;
+    }
+
+    void reserve(std::size_t n) {
+        values.reserve(n);
+        mask.reserve(words(n));
+    }
+
+    void pushOk(const T& value) {
+        grow();
+        values.push(value);
+        mask[count / 64] |= std::uint64_t(1) << (count % 64);
+        ++count;
+    }
+
+    void pushErr(E error) {
+        grow();
+        values.push(T());
+        errors.push_back(IndexedError(count, std::move(error)));
+        ++count;
+    }
+
+    // copies the error out of an lvalue, moves it out of an rvalue
+    template <typename R>
+    void push(R&& result) {
+        typedef typename std::conditional<std::is_lvalue_reference<R>::value,
+                                          const typename std::remove_reference<R>::type&, R&&>::type Source;
+        if (result.isOk()) pushOk(result.asRef().unwrap());
+        else pushErr(static_cast<Source>(result).unwrapErr());
+    }
+
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool isOk(std::size_t i) const { return (mask[i / 64] >> (i % 64)) & 1; }
+
+    // the value column; entries whose bit is clear are Err lanes
+    const T* data() const { return values.data(); }
+    // bit i % 64 of word i / 64 is set when element i is Ok
+    const std::uint64_t* okMask() const { return mask.data(); }
+    // (index, error) for every Err, in index order
+    const std::vector<IndexedError>& errorTable() const { return errors; }
+
+    // the error of element i, which must be an Err
+    const E& errorAt(std::size_t i) const {
+        typename std::vector<IndexedError>::const_iterator it = std::lower_bound(
+            errors.begin(), errors.end(), i, [](const IndexedError& e, std::size_t index) { return e.first < index; });
+        return it->second;
+    }
+
+    // element i as a Result, copied
+    Result<T, E> get(std::size_t i) const {
+        if (isOk(i)) return Result<T, E>::Ok(values.data()[i]);
+        return Result<T, E>::Err(errorAt(i));
+    }
+
+    // f applied to every lane; the mask and the errors are carried over
+    template <typename F>
+    auto map(F f) const -> ResultBatch<decltype(f(std::declval<const T&>())), E> {
+        typedef decltype(f(std::declval<const T&>())) U;
+        ResultBatch<U, E> out;
+        out.count = count;
+        out.values.resize(count);
+        const T* in = values.data();
+        U* column = out.values.data();
+        for (std::size_t base = 0; base < count; base += 64) {
+            result_detail::fillBlock(column + base, std::min<std::size_t>(64, count - base),
+                                     [&](std::size_t j) { return f(in[base + j]); });
+        }
+        out.mask = mask;
+        out.errors = errors;
+        return out;
+    }
+
+    // the Ok values, in order
+    std::vector<T> filterOk() const {
+        std::vector<T> out;
+        out.reserve(count - errors.size());
+        const T* in = values.data();
+        for (std::size_t w = 0; w < mask.size(); ++w) {
+            std::uint64_t bits = mask[w];
+            const T* block = in + w * 64;
+            if (bits == ~std::uint64_t(0)) {
+                out.insert(out.end(), block, block + 64);   // a full word: one bulk copy
+                continue;
+            }
+            while (bits) {
+                out.push_back(block[result_detail::lowestBit(bits)]);
+                bits &= bits - 1;
+            }
+        }
+        return out;
+    }
+
+    std::size_t countOk() const {
+        std::size_t ok = 0;
+        for (std::size_t w = 0; w < mask.size(); ++w) ok += result_detail::popcount64(mask[w]);
+        return ok;
+    }
+
+    std::size_t countErr() const { return count - countOk(); }
+
+private:
+    template <typename U, typename F>
+    friend class ResultBatch;
+
+    static std::size_t words(std::size_t n) { return (n + 63) / 64; }
+
+    // the bits of word w that hold elements
+    std::uint64_t liveBits(std::size_t w) const {
+        std::size_t tail = count - w * 64;
+        return tail >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << tail) - 1;
+    }
+
+    void grow() {
+        if (count % 64 == 0) mask.push_back(0);
+    }
+
+    std::size_t count;
+    result_detail::AlignedColumn<T> values;
+    std::vector<std::uint64_t> mask;
+    std::vector<IndexedError> errors;
+};
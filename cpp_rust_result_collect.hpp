@@ -0,0 +1,179 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <iterator>
+#include <vector>
+
+// ---------------------------
+// Batch collection
+// ---------------------------
+//
+// Turn a range of Result<T, E> into one Result<std::vector<T>, ...>:
+//
+//     auto rows = traverse(records, validate);   // Result<vector<Row>, Error>, first Err wins
+//     auto all = traverseAll(records, validate); // Result<vector<Row>, vector<Error>>
+//     auto ids = collect(std::move(parsed));     // moves the payloads out
+//
+// The output is reserved up front when the range is a forward range.
+// Payloads and errors are forwarded as the range yields them: copied from
+// lvalue ranges, moved from rvalue ranges and move_iterators.
+
+// the errors accumulated by collectAll/traverseAll, in order
+template <typename E>
+struct ErrorFormatter<std::vector<E> > {
+    static void format(const std::vector<E>& errors, std::string& out) {
+        for (std::size_t i = 0; i < errors.size(); ++i) {
+            if (i) out += "; ";
+            ErrorFormatter<E>::format(errors[i], out);
+        }
+    }
+};
+
+namespace result_detail {
+
+template <typename R>
+struct ResultParts;
+
+template <typename T, typename E>
+struct ResultParts<Result<T, E> > {
+    static_assert(!std::is_void<T>::value && !std::is_reference<T>::value,
+                  "collect needs a value payload");
+    typedef T Value;
+    typedef E Error;
+};
+
+template <typename R>
+struct CollectTypes {
+    typedef typename ResultParts<typename std::decay<R>::type>::Value Value;
+    typedef typename ResultParts<typename std::decay<R>::type>::Error Error;
+    typedef Result<std::vector<Value>, Error> First;
+    typedef Result<std::vector<Value>, std::vector<Error> > All;
+};
+
+// the Result yielded by f for an element of It
+template <typename It, typename F>
+struct TraverseTypes : CollectTypes<decltype(std::declval<F&>()(*std::declval<It&>()))> {};
+
+// collect is traverse with an f that hands over the element as is
+template <typename Ref>
+struct ForwardAs {
+    Ref operator()(Ref element) const { return static_cast<Ref>(element); }
+};
+
+template <typename It>
+struct CollectOf : TraverseTypes<It, ForwardAs<typename std::iterator_traits<It>::reference> > {
+    typedef ForwardAs<typename std::iterator_traits<It>::reference> Forward;
+};
+
+// reserve only when the size is known without consuming the range
+template <typename It, typename Vec>
+void reserveFor(It first, It last, Vec& out, std::forward_iterator_tag) {
+    out.reserve(static_cast<std::size_t>(std::distance(first, last)));
+}
+
+template <typename It, typename Vec>
+void reserveFor(It, It, Vec&, std::input_iterator_tag) {}
+
+template <typename It, typename Vec>
+void reserveFor(It first, It last, Vec& out) {
+    reserveFor(first, last, out, typename std::iterator_traits<It>::iterator_category());
+}
+
+// iterators over a range: moving ones when the range is an rvalue
+template <typename Range>
+struct RangeIter {
+    typedef decltype(std::begin(std::declval<Range&>())) Base;
+    typedef typename std::conditional<std::is_lvalue_reference<Range>::value, Base,
+                                      std::move_iterator<Base> >::type type;
+
+    static type make(Base it) { return type(it); }
+};
+
+template <typename It, typename F>
+typename TraverseTypes<It, F>::First traverseFirst(It first, It last, F& f) {
+    typedef typename TraverseTypes<It, F>::First Out;
+    std::vector<typename TraverseTypes<It, F>::Value> values;
+    reserveFor(first, last, values);
+    for (; first != last; ++first) {
+        auto&& result = f(*first);
+        if (!CPP_RUST_RESULT_LIKELY(TryAccess::ok(result))) {
+            return TryAccess::error(static_cast<decltype(result)&&>(result));
+        }
+        values.emplace_back(TryAccess::value(static_cast<decltype(result)&&>(result)));
+    }
+    return Out::Ok(std::move(values));
+}
+
+// every element is visited; once an Err is seen the payloads are dropped
+template <typename It, typename F>
+typename TraverseTypes<It, F>::All traverseAll(It first, It last, F& f) {
+    typedef typename TraverseTypes<It, F>::All Out;
+    std::vector<typename TraverseTypes<It, F>::Value> values;
+    std::vector<typename TraverseTypes<It, F>::Error> errors;
+    reserveFor(first, last, values);
+    for (; first != last; ++first) {
+        auto&& result = f(*first);
+        if (CPP_RUST_RESULT_LIKELY(TryAccess::ok(result))) {
+            if (errors.empty()) values.emplace_back(TryAccess::value(static_cast<decltype(result)&&>(result)));
+        } else {
+            if (errors.empty()) std::vector<typename TraverseTypes<It, F>::Value>().swap(values);
+            errors.emplace_back(TryAccess::error(static_cast<decltype(result)&&>(result)).get());
+        }
+    }
+    if (!errors.empty()) return Out::Err(std::move(errors));
+    return Out::Ok(std::move(values));
+}
+
+} // namespace result_detail
+
+// Result<vector<T>, E>: the payloads, or the first Err
+template <typename InputIt>
+typename result_detail::CollectOf<InputIt>::First collect(InputIt first, InputIt last) {
+    typename result_detail::CollectOf<InputIt>::Forward forward;
+    return result_detail::traverseFirst(first, last, forward);
+}
+
+template <typename Range>
+typename result_detail::CollectOf<typename result_detail::RangeIter<Range>::type>::First
+collect(Range&& range) {
+    typedef result_detail::RangeIter<Range> Iter;
+    return collect(Iter::make(std::begin(range)), Iter::make(std::end(range)));
+}
+
+// Result<vector<T>, vector<E>>: the payloads, or every Err in order
+template <typename InputIt>
+typename result_detail::CollectOf<InputIt>::All collectAll(InputIt first, InputIt last) {
+    typename result_detail::CollectOf<InputIt>::Forward forward;
+    return result_detail::traverseAll(first, last, forward);
+}
+
+template <typename Range>
+typename result_detail::CollectOf<typename result_detail::RangeIter<Range>::type>::All
+collectAll(Range&& range) {
+    typedef result_detail::RangeIter<Range> Iter;
+    return collectAll(Iter::make(std::begin(range)), Iter::make(std::end(range)));
+}
+
+// f maps each element to a Result<T, E>; the first Err stops the walk
+template <typename InputIt, typename F>
+typename result_detail::TraverseTypes<InputIt, F>::First traverse(InputIt first, InputIt last, F f) {
+    return result_detail::traverseFirst(first, last, f);
+}
+
+template <typename Range, typename F>
+typename result_detail::TraverseTypes<typename result_detail::RangeIter<Range>::type, F>::First
+traverse(Range&& range, F f) {
+    typedef result_detail::RangeIter<Range> Iter;
+    return result_detail::traverseFirst(Iter::make(std::begin(range)), Iter::make(std::end(range)), f);
+}
+
+template <typename InputIt, typename F>
+typename result_detail::TraverseTypes<InputIt, F>::All traverseAll(InputIt first, InputIt last, F f) {
+    return result_detail::traverseAll(first, last, f);
+}
+
+template <typename Range, typename F>
+typename result_detail::TraverseTypes<typename result_detail::RangeIter<Range>::type, F>::All
+traverseAll(Range&& range, F f) {
+    typedef result_detail::RangeIter<Range> Iter;
+    return result_detail::traverseAll(Iter::make(std::begin(range)), Iter::make(std::end(range)), f);
+}
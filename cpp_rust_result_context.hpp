@@ -0,0 +1,248 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// ---------------------------
+// Error context chains
+// ---------------------------
+//
+// ContextError<E> is an E plus a chain of context frames, each a static
+// string and an optional integer detail. Frames live in a per-thread bump
+// arena, so adding one costs a pointer bump and a push; the chain is only
+// rendered when the error is formatted, outermost frame first:
+//
+//     Result<Config, ContextError<std::string>> loadConfig(const std::string& path) {
+//         RESULT_TRY_ASSIGN(std::string text, withContext(readFile(path), "reading config"));
+//         return withContext(parseConfig(text), "parsing config", lineOf(text));
+//     }
+//
+//     void handle(const Request& request) {
+//         ContextScope scope;   // frames added below are released when it closes
+//         loadConfig(request.path)
+//             .mapError(addContext("handling request", request.id))
+//             .unwrapOrLog("handle", Config());   // "handling request (7): reading config: ..."
+//     }
+//
+// A ContextError must not be formatted after the scope (or the reset) that
+// released its frames, nor on another thread once that thread's arena has
+// moved past them.
+struct ContextFrame {
+    const char* text;
+    std::int64_t detail;   // 0 for none
+    const ContextFrame* next;
+};
+
+// Fixed-size blocks kept on a list; a reset rewinds into them rather than
+// freeing them, so a thread stops allocating once its deepest request fits.
+// The state is trivially destructible and the blocks are freed by a reaper
+// registered with the first block, as FrameCache does for coroutine frames.
+class ContextArena {
+    struct Block {
+        Block* next;
+        std::size_t used;
+        ContextFrame frames[170];   // about 4 KiB per block
+    };
+
+    struct State {
+        Block* first;
+        Block* current;
+    };
+
+    struct Reaper {
+        ~Reaper() {
+            State& arena = state();
+            while (Block* block = arena.first) {
+                arena.first = block->next;
+                ::operator delete(block);
+            }
+            arena.current = nullptr;
+        }
+    };
+
+    static State& state() {
+        static thread_local State arena;
+        return arena;
+    }
+
+    static Block* grow(State& arena) {
+        if (arena.current && arena.current->next) {
+            arena.current = arena.current->next;
+            arena.current->used = 0;
+            return arena.current;
+        }
+        Block* block = static_cast<Block*>(::operator new(sizeof(Block)));
+        block->next = nullptr;
+        block->used = 0;
+        if (arena.current) {
+            arena.current->next = block;
+        } else {
+            static thread_local Reaper reaper;
+            (void)reaper;
+            arena.first = block;
+        }
+        arena.current = block;
+        return block;
+    }
+
+public:
+    // a position to rewind to
+    struct Mark {
+        Block* block;
+        std::size_t used;
+    };
+
+    static const ContextFrame* push(const char* text, std::int64_t detail, const ContextFrame* next) {
+        State& arena = state();
+        Block* block = arena.current;
+        if (!CPP_RUST_RESULT_LIKELY(block && block->used < sizeof(block->frames) / sizeof(ContextFrame))) {
+            block = grow(arena);
+        }
+        ContextFrame* frame = &block->frames[block->used++];
+        frame->text = text;
+        frame->detail = detail;
+        frame->next = next;
+        return frame;
+    }
+
+    static Mark mark() {
+        State& arena = state();
+        Mark position = { arena.current, arena.current ? arena.current->used : 0 };
+        return position;
+    }
+
+    static void rewind(Mark position) {
+        State& arena = state();
+        if (position.block) {
+            arena.current = position.block;
+            position.block->used = position.used;
+        } else if (arena.first) {
+            arena.current = arena.first;
+            arena.first->used = 0;
+        }
+    }
+
+    // releases every frame of this thread
+    static void reset() {
+        Mark start = { nullptr, 0 };
+        rewind(start);
+    }
+};
+
+// releases the frames added while it is open
+class ContextScope {
+public:
+    ContextScope() : start(ContextArena::mark()) {}
+    ~ContextScope() { ContextArena::rewind(start); }
+
+    ContextScope(const ContextScope&) = delete;
+    ContextScope& operator=(const ContextScope&) = delete;
+
+private:
+    ContextArena::Mark start;
+};
+
+template <typename E>
+class ContextError {
+public:
+    // an E without context, so RESULT_TRY forwards plain errors into it
+    ContextError(E error) : err(std::move(error)), frames(nullptr) {}
+    ContextError(E error, const ContextFrame* frames) : err(std::move(error)), frames(frames) {}
+
+    const E& error() const& { return err; }
+    E&& error() && { return std::move(err); }
+
+    // the outermost frame; follow next towards the error
+    const ContextFrame* context() const { return frames; }
+
+    ContextError with(const char* text, std::int64_t detail = 0) const& {
+        return ContextError(err, ContextArena::push(text, detail, frames));
+    }
+    ContextError with(const char* text, std::int64_t detail = 0) && {
+        return ContextError(std::move(err), ContextArena::push(text, detail, frames));
+    }
+
+private:
+    E err;
+    const ContextFrame* frames;
+};
+
+// "outer (detail): inner: error"
+template <typename E>
+struct ErrorFormatter<ContextError<E> > {
+    static void format(const ContextError<E>& error, std::string& out) {
+        for (const ContextFrame* frame = error.context(); frame; frame = frame->next) {
+            out += frame->text;
+            if (frame->detail != 0) {
+                out += " (";
+                out += std::to_string(frame->detail);
+                out += ')';
+            }
+            out += ": ";
+        }
+        ErrorFormatter<E>::format(error.error(), out);
+    }
+};
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+template <typename E>
+std::ostream& operator<<(std::ostream& os, const ContextError<E>& error) {
+    std::string text;
+    ErrorFormatter<ContextError<E> >::format(error, text);
+    return os << text;
+}
+#endif
+
+namespace result_detail {
+
+template <typename E>
+struct WithContext {
+    typedef ContextError<E> type;
+    static type add(E&& error, const char* text, std::int64_t detail) {
+        return type(std::move(error), ContextArena::push(text, detail, nullptr));
+    }
+    static type add(const E& error, const char* text, std::int64_t detail) {
+        return type(error, ContextArena::push(text, detail, nullptr));
+    }
+};
+
+// context on a ContextError extends its chain rather than nesting
+template <typename E>
+struct WithContext<ContextError<E> > {
+    typedef ContextError<E> type;
+    static type add(ContextError<E>&& error, const char* text, std::int64_t detail) {
+        return std::move(error).with(text, detail);
+    }
+    static type add(const ContextError<E>& error, const char* text, std::int64_t detail) {
+        return error.with(text, detail);
+    }
+};
+
+} // namespace result_detail
+
+// the mapError step behind withContext: r.mapError(addContext("loading"))
+class AddContext {
+public:
+    AddContext(const char* text, std::int64_t detail) : text(text), detail(detail) {}
+
+    template <typename E>
+    typename result_detail::WithContext<typename std::decay<E>::type>::type operator()(E&& error) const {
+        return result_detail::WithContext<typename std::decay<E>::type>::add(std::forward<E>(error), text, detail);
+    }
+
+private:
+    const char* text;
+    std::int64_t detail;
+};
+
+// text must outlive the error, which a string literal does
+inline AddContext addContext(const char* text, std::int64_t detail = 0) { return AddContext(text, detail); }
+
+// Result<T, ContextError<E>> with one more frame on an Err; an Ok passes
+// through untouched
+template <typename R>
+auto withContext(R&& result, const char* text, std::int64_t detail = 0)
+    -> decltype(std::forward<R>(result).mapError(addContext(text, detail))) {
+    return std::forward<R>(result).mapError(addContext(text, detail));
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+
+// ---------------------------
+// Interned errors
+// ---------------------------
+//
+// ErrorId is a 16-byte, trivially copyable error: a pointer to a message
+// interned once for the whole process plus an integer detail (an errno, a
+// line number, an index; 0 for none). Creating, copying and comparing one
+// never allocates, and the text is only formatted when a hook or
+// unwrapErr asks for it:
+//
+//     Result<double, ErrorId> divide(double a, double b) {
+//         if (b == 0.0) return Result<double, ErrorId>::Err(RESULT_ERROR_ID("Division by zero"));
+//         return Result<double, ErrorId>::Ok(a / b);
+//     }
+//
+//     readFile(path).mapError([](ErrorId e) { return RESULT_ERROR_ID("File error").withDetail(e.detail()); });
+//
+// Equal texts intern to the same pointer, so ids compare by address.
+class ErrorId;
+
+namespace result_detail {
+
+// Messages live in the nodes of an unordered_set, which never move. The
+// table is leaked so that ids stay valid during static destruction.
+class MessageTable {
+public:
+    static MessageTable& instance() {
+        static MessageTable* table = new MessageTable();
+        return *table;
+    }
+
+    const char* intern(const std::string& text) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return messages.insert(text).first->c_str();
+    }
+
+private:
+    MessageTable() {}
+
+    std::mutex mutex;
+    std::unordered_set<std::string> messages;
+};
+
+} // namespace result_detail
+
+class ErrorId {
+public:
+    // takes the table lock; RESULT_ERROR_ID caches the id of a literal
+    static ErrorId intern(const std::string& text) {
+        return ErrorId(result_detail::MessageTable::instance().intern(text), 0);
+    }
+
+    // the same message with another detail
+    ErrorId withDetail(std::int64_t detail) const { return ErrorId(text, detail); }
+
+    const char* message() const { return text; }
+    std::int64_t detail() const { return value; }
+
+    friend bool operator==(ErrorId a, ErrorId b) { return a.text == b.text && a.value == b.value; }
+    friend bool operator!=(ErrorId a, ErrorId b) { return !(a == b); }
+
+    // the message without the detail
+    bool is(ErrorId other) const { return text == other.text; }
+
+private:
+    friend struct NicheTraits<ErrorId>;
+
+    ErrorId(const char* text, std::int64_t value) : text(text), value(value) {}
+
+    const char* text;     // interned, never null for a real id
+    std::int64_t value;
+};
+
+// an interned message never has a null text, which leaves null free to mark
+// Ok: sizeof(Result<void, ErrorId>) == sizeof(ErrorId)
+template <>
+struct NicheTraits<ErrorId> {
+    static const bool available = true;
+    static ErrorId sentinel() { return ErrorId(nullptr, 0); }
+    static bool isSentinel(const ErrorId& id) { return id.text == nullptr; }
+};
+
+// "message" or "message (detail)"
+template <>
+struct ErrorFormatter<ErrorId> {
+    static void format(ErrorId id, std::string& out) {
+        out += id.message();
+        if (id.detail() != 0) {
+            out += " (";
+            out += std::to_string(id.detail());
+            out += ')';
+        }
+    }
+};
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+inline std::ostream& operator<<(std::ostream& os, ErrorId id) {
+    os << id.message();
+    if (id.detail() != 0) os << " (" << id.detail() << ')';
+    return os;
+}
+#endif
+
+// the id of a string literal, interned on first use at this site
+#define RESULT_ERROR_ID(literal) \
+    ([]() -> ErrorId { static const ErrorId id = ErrorId::intern(literal); return id; }())
@@ -0,0 +1,235 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <cerrno>
+#include <cstddef>
+#include <string>
+#include <system_error>
+#if defined(_WIN32)
+#include <cstdio>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// ---------------------------
+// File input
+// ---------------------------
+//
+// mapFile(path) maps a regular file read-only and hands back a view over
+// the bytes exactly as they are on disk, without copying them or
+// rewriting line endings:
+//
+//     auto size = mapFile("input.bin")
+//         .map([](const MappedFile& file) { return file.size(); });
+//
+//     RESULT_TRY_ASSIGN(MappedFile file, mapFile(path));
+//     scan(file.data(), file.size());      // valid while file lives
+//
+// Pipes, character devices, files that report a size of 0 (such as
+// /proc entries), and every file on Windows are read instead. The whole
+// input goes into one buffer owned by the MappedFile, so callers see the
+// same view either way. readFileResult(path) always takes that path. Use it
+// when the file may be truncated while it is in use, which would fault
+// a mapping.
+//
+// Failures carry the errno of the call that failed, its name and the path.
+struct IoError {
+    int code;                // errno value
+    const char* operation;   // "open", "fstat", "mmap" or "read"
+    std::string path;
+
+    std::error_code error() const { return std::error_code(code, std::generic_category()); }
+
+    // "open: data.txt: No such file or directory"
+    std::string message() const {
+        std::string out = operation;
+        out += ": ";
+        out += path;
+        out += ": ";
+        out += std::generic_category().message(code);
+        return out;
+    }
+};
+
+template <>
+struct ErrorFormatter<IoError> {
+    static void format(const IoError& err, std::string& out) { out += err.message(); }
+};
+
+#if !defined(CPP_RUST_RESULT_NO_DYNAMIC_HOOKS)
+inline std::ostream& operator<<(std::ostream& os, const IoError& err) { return os << err.message(); }
+#endif
+
+class MappedFile;
+inline Result<MappedFile, IoError> mapFile(const std::string& path);
+inline Result<MappedFile, IoError> readFileResult(const std::string& path);
+
+// Read-only bytes of a file, either a private mapping or an owned buffer.
+// Move-only; data() stays valid until the MappedFile is destroyed.
+class MappedFile {
+public:
+    MappedFile() : region(nullptr), length(0) {}
+
+    MappedFile(MappedFile&& other) noexcept
+        : region(other.region), length(other.length), buffer(std::move(other.buffer)) {
+        other.region = nullptr;
+        other.length = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            release();
+            region = other.region;
+            length = other.length;
+            buffer = std::move(other.buffer);
+            other.region = nullptr;
+            other.length = 0;
+        }
+        return *this;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() { release(); }
+
+    const char* data() const { return region ? static_cast<const char*>(region) : buffer.data(); }
+    std::size_t size() const { return region ? length : buffer.size(); }
+    bool empty() const { return size() == 0; }
+
+    const char* begin() const { return data(); }
+    const char* end() const { return data() + size(); }
+
+    // true when the bytes are a mapping rather than a buffer read from the file
+    bool mapped() const { return region != nullptr; }
+
+    // an owned copy
+    std::string str() const { return std::string(data(), size()); }
+
+private:
+    friend Result<MappedFile, IoError> mapFile(const std::string& path);
+    friend Result<MappedFile, IoError> readFileResult(const std::string& path);
+
+    void release() {
+#if !defined(_WIN32)
+        if (region) ::munmap(region, length);
+#endif
+        region = nullptr;
+        length = 0;
+    }
+
+    void* region;          // the mapping, or null when the bytes are in buffer
+    std::size_t length;
+    std::string buffer;
+};
+
+namespace result_detail {
+
+inline Result<MappedFile, IoError> ioFailure(const char* operation, const std::string& path) {
+    IoError error = { errno, operation, path };
+    return Result<MappedFile, IoError>::Err(std::move(error));
+}
+
+#if !defined(_WIN32)
+
+// Closes the descriptor on every path out of mapFile/readFileResult.
+struct FileDescriptor {
+    int fd;
+
+    explicit FileDescriptor(int fd) : fd(fd) {}
+    ~FileDescriptor() {
+        if (fd >= 0) ::close(fd);
+    }
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+};
+
+inline int openReadOnly(const std::string& path) {
+#if defined(O_CLOEXEC)
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+#else
+    return ::open(path.c_str(), O_RDONLY);
+#endif
+}
+
+// Reads fd to the end into buffer, sized from expected up front and
+// doubled when a growing or non-regular file outruns it.
+inline bool readAll(int fd, std::size_t expected, std::string& buffer) {
+    buffer.resize(expected ? expected + 1 : 64 * 1024);   // +1 sees EOF without growing
+    std::size_t used = 0;
+    for (;;) {
+        if (used == buffer.size()) buffer.resize(buffer.size() * 2);
+        ssize_t n = ::read(fd, &buffer[used], buffer.size() - used);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        if (n == 0) break;
+        used += static_cast<std::size_t>(n);
+    }
+    buffer.resize(used);
+    return true;
+}
+
+#endif
+
+} // namespace result_detail
+
+// Maps path read-only, or reads it when it cannot be mapped (see above).
+inline Result<MappedFile, IoError> mapFile(const std::string& path) {
+#if defined(_WIN32)
+    return readFileResult(path);
+#else
+    result_detail::FileDescriptor file(result_detail::openReadOnly(path));
+    if (file.fd < 0) return result_detail::ioFailure("open", path);
+    struct stat info;
+    if (::fstat(file.fd, &info) != 0) return result_detail::ioFailure("fstat", path);
+
+    MappedFile out;
+    if (S_ISREG(info.st_mode) && info.st_size > 0) {
+        std::size_t length = static_cast<std::size_t>(info.st_size);
+        void* region = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, file.fd, 0);
+        if (region != MAP_FAILED) {
+#if defined(MADV_SEQUENTIAL)
+            ::madvise(region, length, MADV_SEQUENTIAL);   // a hint; failure changes nothing
+#endif
+            out.region = region;
+            out.length = length;
+            return Result<MappedFile, IoError>::Ok(std::move(out));
+        }
+        // a file system without mmap support is read instead
+        if (errno != ENODEV) return result_detail::ioFailure("mmap", path);
+    }
+    std::size_t expected = S_ISREG(info.st_mode) ? static_cast<std::size_t>(info.st_size) : 0;
+    if (!result_detail::readAll(file.fd, expected, out.buffer)) return result_detail::ioFailure("read", path);
+    return Result<MappedFile, IoError>::Ok(std::move(out));
+#endif
+}
+
+// Reads all of path into one buffer owned by the result, with no mapping.
+inline Result<MappedFile, IoError> readFileResult(const std::string& path) {
+    MappedFile out;
+#if defined(_WIN32)
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return result_detail::ioFailure("open", path);
+    std::size_t used = 0;
+    do {
+        if (used == out.buffer.size()) out.buffer.resize(out.buffer.empty() ? 64 * 1024 : out.buffer.size() * 2);
+        used += std::fread(&out.buffer[used], 1, out.buffer.size() - used, file);
+    } while (used == out.buffer.size());
+    bool failed = std::ferror(file) != 0;
+    std::fclose(file);
+    if (failed) return result_detail::ioFailure("read", path);
+    out.buffer.resize(used);
+#else
+    result_detail::FileDescriptor file(result_detail::openReadOnly(path));
+    if (file.fd < 0) return result_detail::ioFailure("open", path);
+    struct stat info;
+    if (::fstat(file.fd, &info) != 0) return result_detail::ioFailure("fstat", path);
+    std::size_t expected = S_ISREG(info.st_mode) ? static_cast<std::size_t>(info.st_size) : 0;
+    if (!result_detail::readAll(file.fd, expected, out.buffer)) return result_detail::ioFailure("read", path);
+#endif
+    return Result<MappedFile, IoError>::Ok(std::move(out));
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// ---------------------------
+// Per-site log limiting
+// ---------------------------
+
+struct LogLimitOptions {
+    std::uint32_t sample_every;                // forward 1 record in N per site; 1 keeps all
+    double per_second;                         // token refill rate per site; 0 for no limit
+    double burst;                              // tokens a quiet site accumulates
+    std::chrono::milliseconds dedupe_window;   // drop a repeat of a site's last line; 0 disables
+    std::chrono::milliseconds summary_every;   // how often suppressed counts are reported
+
+    LogLimitOptions()
+        : sample_every(1), per_second(10), burst(20), dedupe_window(1000), summary_every(10000) {}
+};
+
+// records forwarded and dropped since construction, by the filter that dropped them
+struct LogLimitStats {
+    std::uint64_t forwarded;
+    std::uint64_t fatal;          // forwarded without filtering; included in forwarded
+    std::uint64_t sampled;
+    std::uint64_t rate_limited;
+    std::uint64_t duplicates;
+};
+
+// A record hook that filters records per call site before handing the
+// survivors to a string sink (an AsyncLogSink, a file writer):
+//
+//     static LogLimiter limiter(sink.logHook());
+//     ResultHooks::setRecordHook(limiter.recordHook());
+//     ...
+//     r.unwrapOrLog(RESULT_SITE("safe division"), 0.0);
+//
+// Records pass three filters in turn, cheapest first:
+//  - 1-in-N sampling on a per-site counter
+//  - a per-site token bucket (GCRA: one atomic timestamp per site)
+//  - deduplication of a site's last line within a window, by hash
+// Only records that reach the third filter are formatted. Records without a
+// RESULT_SITE share one budget. One line per site reports how many records
+// it suppressed: from submit() once summary_every has passed, and on
+// destruction or flushSummary(). There is no timer thread, so counts from a
+// burst followed by silence wait for the next record from any site; call
+// flushSummary() from the application's own periodic work to bound that
+// delay. stats() has the running totals by filter.
+//
+// Fatal records skip all three: the line written before the terminate hook
+// runs is never dropped. The pending summary lines are sent just ahead of
+// it, since the process will not live to send them later.
+//
+// Sites map to a fixed table of slots by address; when a probe finds no free
+// slot the site shares the overflow slot with the untagged records.
+class LogLimiter {
+    static const std::size_t slot_count = 256;
+    static const std::size_t probe_limit = 8;
+
+    struct Slot {
+        std::atomic<const LogSite*> site;
+        std::atomic<std::uint32_t> seen;
+        std::atomic<std::uint64_t> suppressed;
+        std::atomic<std::int64_t> theoretical_arrival;   // GCRA state, ns
+        std::atomic<std::uint64_t> last_hash;
+        std::atomic<std::int64_t> last_time;             // ns
+    };
+
+public:
+    explicit LogLimiter(ResultHooks::LogHook sink, LogLimitOptions options = LogLimitOptions())
+        : sink(std::move(sink)), options(options), slots(new Slot[slot_count + 1]),
+          interval_ns(options.per_second > 0 ? static_cast<std::int64_t>(1e9 / options.per_second) : 0),
+          tolerance_ns(static_cast<std::int64_t>(interval_ns * (options.burst > 1 ? options.burst - 1 : 0))),
+          next_summary(now() + nanos(options.summary_every)), forwarded(0), fatal(0), sampled(0),
+          rate_limited(0), duplicates(0) {
+        for (std::size_t i = 0; i <= slot_count; ++i) {
+            Slot& slot = slots[i];
+            slot.site.store(nullptr, std::memory_order_relaxed);
+            slot.seen.store(0, std::memory_order_relaxed);
+            slot.suppressed.store(0, std::memory_order_relaxed);
+            slot.theoretical_arrival.store(0, std::memory_order_relaxed);
+            slot.last_hash.store(0, std::memory_order_relaxed);
+            slot.last_time.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    ~LogLimiter() { flushSummary(); }
+
+    LogLimiter(const LogLimiter&) = delete;
+    LogLimiter& operator=(const LogLimiter&) = delete;
+
+    ResultHooks::RecordHook recordHook() { return [this](const LogRecord& record) { submit(record); }; }
+
+    // true when the record was forwarded to the sink
+    bool submit(const LogRecord& record) {
+        if (record.severity == LogSeverity::Fatal) {
+            flushSummary();
+            sink(record.text());
+            fatal.fetch_add(1, std::memory_order_relaxed);
+            forwarded.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        std::int64_t time = now();
+        bool admitted = admit(slotFor(record.site), record, time);
+        std::int64_t due = next_summary.load(std::memory_order_relaxed);
+        if (time >= due && next_summary.compare_exchange_strong(due, time + nanos(options.summary_every),
+                                                                std::memory_order_relaxed)) {
+            flushSummary();
+        }
+        return admitted;
+    }
+
+    // reports and clears the per-site suppressed counts now; safe to call
+    // from any thread, e.g. a housekeeping timer, while records are submitted
+    void flushSummary() {
+        for (std::size_t i = 0; i <= slot_count; ++i) {
+            std::uint64_t count = slots[i].suppressed.exchange(0, std::memory_order_relaxed);
+            if (count == 0) continue;
+            std::string line = "Suppressed ";
+            line += std::to_string(count);
+            line += " log records from ";
+            const LogSite* site = slots[i].site.load(std::memory_order_acquire);
+            if (i == slot_count || !site) {
+                line += "untagged call sites";
+            } else {
+                line += site->file;
+                line += ':';
+                line += std::to_string(site->line);
+                if (site->context && *site->context) {
+                    line += " (";
+                    line += site->context;
+                    line += ')';
+                }
+            }
+            sink(line);
+        }
+    }
+
+    LogLimitStats stats() const {
+        LogLimitStats out = { forwarded.load(std::memory_order_relaxed), fatal.load(std::memory_order_relaxed),
+                              sampled.load(std::memory_order_relaxed), rate_limited.load(std::memory_order_relaxed),
+                              duplicates.load(std::memory_order_relaxed) };
+        return out;
+    }
+
+    // records dropped by any filter
+    std::uint64_t suppressed() const {
+        LogLimitStats s = stats();
+        return s.sampled + s.rate_limited + s.duplicates;
+    }
+
+private:
+    static std::int64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    static std::int64_t nanos(std::chrono::milliseconds ms) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(ms).count();
+    }
+
+    Slot& slotFor(const LogSite* site) {
+        if (!site) return slots[slot_count];
+        std::size_t start = (reinterpret_cast<std::uintptr_t>(site) >> 4) * 0x9E3779B97F4A7C15ULL >> 56;
+        for (std::size_t k = 0; k < probe_limit; ++k) {
+            Slot& slot = slots[(start + k) % slot_count];
+            const LogSite* owner = slot.site.load(std::memory_order_acquire);
+            if (owner == site) return slot;
+            if (!owner && slot.site.compare_exchange_strong(owner, site, std::memory_order_acq_rel)) return slot;
+            if (owner == site) return slot;   // lost the race to the same site
+        }
+        return slots[slot_count];
+    }
+
+    bool admit(Slot& slot, const LogRecord& record, std::int64_t time) {
+        if (options.sample_every > 1 &&
+            slot.seen.fetch_add(1, std::memory_order_relaxed) % options.sample_every != 0) {
+            return suppress(slot, sampled);
+        }
+        if (interval_ns > 0 && !takeToken(slot, time)) return suppress(slot, rate_limited);
+
+        const std::string& text = record.text();
+        if (options.dedupe_window.count() > 0) {
+            std::uint64_t hash = fnv1a(text);
+            std::int64_t window = nanos(options.dedupe_window);
+            if (slot.last_hash.load(std::memory_order_relaxed) == hash &&
+                time - slot.last_time.load(std::memory_order_relaxed) < window) {
+                return suppress(slot, duplicates);
+            }
+            slot.last_hash.store(hash, std::memory_order_relaxed);
+            slot.last_time.store(time, std::memory_order_relaxed);
+        }
+        sink(text);
+        forwarded.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // GCRA: conforming while the theoretical arrival time is no more than
+    // tolerance ahead of now
+    bool takeToken(Slot& slot, std::int64_t time) {
+        std::int64_t arrival = slot.theoretical_arrival.load(std::memory_order_relaxed);
+        for (;;) {
+            std::int64_t start = arrival > time ? arrival : time;
+            if (start - time > tolerance_ns) return false;
+            if (slot.theoretical_arrival.compare_exchange_weak(arrival, start + interval_ns,
+                                                               std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+    bool suppress(Slot& slot, std::atomic<std::uint64_t>& reason) {
+        slot.suppressed.fetch_add(1, std::memory_order_relaxed);
+        reason.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    static std::uint64_t fnv1a(const std::string& text) {
+        std::uint64_t hash = 0xcbf29ce484222325ULL;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            hash ^= static_cast<unsigned char>(text[i]);
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+
+    ResultHooks::LogHook sink;
+    const LogLimitOptions options;
+    std::unique_ptr<Slot[]> slots;   // slot_count by address, then the overflow slot
+    const std::int64_t interval_ns;
+    const std::int64_t tolerance_ns;
+    std::atomic<std::int64_t> next_summary;
+    std::atomic<std::uint64_t> forwarded;
+    std::atomic<std::uint64_t> fatal;
+    std::atomic<std::uint64_t> sampled;
+    std::atomic<std::uint64_t> rate_limited;
+    std::atomic<std::uint64_t> duplicates;
+};
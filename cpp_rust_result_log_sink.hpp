@@ -0,0 +1,243 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// ---------------------------
+// Asynchronous batched log sink
+// ---------------------------
+
+// What push() does when the ring buffer is full.
+enum class LogOverflowPolicy {
+    Drop,    // discard the message
+    Block,   // wait for the writer thread to free a slot
+    Count    // discard, and have the writer report how many were lost
+};
+
+// Bounded MPSC ring buffer drained by a background thread that writes whole
+// batches and flushes the stream once per batch, so logging threads never
+// issue a syscall. flush() is synchronous; install flushHook() through
+// ResultHooks::setFlushHook so FATAL lines are on disk before terminate.
+//
+//     static std::ofstream file("errors.log", std::ios::app);
+//     static AsyncLogSink sink(file);
+//     ResultHooks::setRecordHook(sink.recordHook());
+//     ResultHooks::setFlushHook(sink.flushHook());
+//
+// recordHook() knows each record's severity: a Fatal line waits for a free
+// slot whatever the overflow policy, so a flood of errors cannot push out
+// the line written before terminate. logHook() only sees strings and
+// applies the policy to everything.
+class AsyncLogSink {
+    struct Cell {
+        std::atomic<std::size_t> sequence;
+        std::string message;
+    };
+
+public:
+    explicit AsyncLogSink(std::ostream& out, std::size_t capacity = 1024,
+                          LogOverflowPolicy policy = LogOverflowPolicy::Count)
+        : out(out), policy(policy), mask(roundUp(capacity) - 1),
+          cells(new Cell[mask + 1]), enqueue_pos(0), dequeue_pos(0),
+          dropped_total(0), dropped_unreported(0), sleeping(false), stopping(false) {
+        for (std::size_t i = 0; i <= mask; ++i) cells[i].sequence.store(i, std::memory_order_relaxed);
+        writer = std::thread(&AsyncLogSink::run, this);
+    }
+
+    // drains everything already pushed, then joins the writer thread
+    ~AsyncLogSink() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+    }
+
+    AsyncLogSink(const AsyncLogSink&) = delete;
+    AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+    // returns false when the message was discarded by the overflow policy
+    bool push(const std::string& message) { return enqueue(message, false); }
+    bool push(std::string&& message) { return enqueue(std::move(message), false); }
+
+    // a Fatal message is never discarded: it waits for a slot under any policy
+    bool push(std::string message, LogSeverity severity) {
+        return enqueue(std::move(message), severity == LogSeverity::Fatal);
+    }
+
+    // blocks until every message pushed before the call has been written
+    void flush() {
+        std::size_t target = enqueue_pos.load(std::memory_order_acquire);
+        std::unique_lock<std::mutex> lock(mutex);
+        flush_target = std::max(flush_target, target);
+        wake.notify_one();
+        drained.wait(lock, [&] { return dequeue_pos.load(std::memory_order_acquire) >= target || stopped; });
+    }
+
+    std::size_t dropped() const { return dropped_total.load(std::memory_order_relaxed); }
+
+    ResultHooks::LogHook logHook() { return [this](const std::string& message) { push(message); }; }
+
+    // format(record, line) appends the line to write; LogRecord::render by default
+    ResultHooks::RecordHook recordHook() { return recordHook(&renderRecord); }
+
+    template <typename Format>
+    ResultHooks::RecordHook recordHook(Format format) {
+        return [this, format](const LogRecord& record) {
+            std::string line;
+            format(record, line);
+            push(std::move(line), record.severity);
+        };
+    }
+    ResultHooks::FlushHook flushHook() { return [this]() { flush(); }; }
+
+private:
+    static void renderRecord(const LogRecord& record, std::string& out) { record.render(out); }
+
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t size = 2;
+        while (size < n) size <<= 1;
+        return size;
+    }
+
+    // Vyukov bounded queue; producers copy (or swap) into the cell's string so
+    // a warmed-up buffer reuses its capacity instead of allocating. message is
+    // only consumed when a cell was claimed, so a failed attempt can retry.
+    template <typename Message>
+    bool tryEnqueue(Message&& message) {
+        std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells[pos & mask];
+            std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+        store(cell->message, std::forward<Message>(message));
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    static void store(std::string& slot, const std::string& message) { slot.assign(message); }
+    static void store(std::string& slot, std::string&& message) { slot.swap(message); }
+
+    // wait: block for a slot even when the policy would discard
+    template <typename Message>
+    bool enqueue(Message&& message, bool wait) {
+        bool pushed = tryEnqueue(std::forward<Message>(message));
+        while (!pushed && (wait || policy == LogOverflowPolicy::Block)) {
+            notifyWriter();
+            std::this_thread::yield();
+            pushed = tryEnqueue(std::forward<Message>(message));
+        }
+        if (!pushed) {
+            dropped_total.fetch_add(1, std::memory_order_relaxed);
+            if (policy == LogOverflowPolicy::Count) dropped_unreported.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        notifyWriter();
+        return true;
+    }
+
+    // only pay for the mutex when the writer is actually asleep
+    void notifyWriter() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wake.notify_one();
+        }
+    }
+
+    bool readable() const {
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        return cells[pos & mask].sequence.load(std::memory_order_acquire) == pos + 1;
+    }
+
+    // moves every published message into the batch and releases the cells
+    std::size_t collect() {
+        std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        std::size_t count = 0;
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            if (cell.sequence.load(std::memory_order_acquire) != pos + 1) break;
+            if (count == batch.size()) batch.push_back(std::string());
+            batch[count].swap(cell.message);
+            cell.message.clear();
+            cell.sequence.store(pos + mask + 1, std::memory_order_release);
+            ++pos;
+            ++count;
+        }
+        pending_pos = pos;
+        return count;
+    }
+
+    void write(std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) out << batch[i] << '\n';
+        std::size_t lost = dropped_unreported.exchange(0, std::memory_order_relaxed);
+        if (lost) out << "[AsyncLogSink] " << lost << " messages dropped" << '\n';
+        out.flush();
+    }
+
+    void run() {
+        for (;;) {
+            std::size_t count = collect();
+            if (count || dropped_unreported.load(std::memory_order_relaxed)) {
+                write(count);
+                std::lock_guard<std::mutex> lock(mutex);
+                dequeue_pos.store(pending_pos, std::memory_order_release);
+                if (flush_target) drained.notify_all();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!readable() && !stopping && flush_target <= dequeue_pos.load(std::memory_order_relaxed)) {
+                wake.wait_for(lock, std::chrono::milliseconds(50));
+            }
+            sleeping.store(false, std::memory_order_relaxed);
+            if (stopping && !readable()) {
+                stopped = true;
+                drained.notify_all();
+                return;
+            }
+        }
+    }
+
+    std::ostream& out;
+    const LogOverflowPolicy policy;
+    const std::size_t mask;
+    std::unique_ptr<Cell[]> cells;
+
+    alignas(64) std::atomic<std::size_t> enqueue_pos;
+    alignas(64) std::atomic<std::size_t> dequeue_pos;
+    std::size_t pending_pos = 0;          // writer thread only
+    std::vector<std::string> batch;       // writer thread only
+
+    std::atomic<std::size_t> dropped_total;
+    std::atomic<std::size_t> dropped_unreported;
+    std::atomic<bool> sleeping;
+
+    std::mutex mutex;                     // guards the fields below, never held by producers
+    std::condition_variable wake;
+    std::condition_variable drained;
+    std::size_t flush_target = 0;
+    bool stopping;
+    bool stopped = false;
+
+    std::thread writer;
+};
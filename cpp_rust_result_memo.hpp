@@ -0,0 +1,238 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// ---------------------------
+// Memoization
+// ---------------------------
+//
+// memoize(f, capacity) wraps a pure one-argument stage that returns a
+// Result<T, E> in a bounded, sharded LRU cache, and can stand wherever f
+// does, andThen included:
+//
+//     static auto parse = memoize(parseInput, 4096);
+//     auto value = readFile(path).andThen(parse).map(measure);
+//
+//     MemoView<Result<std::string, std::string> > hit = parse.view(text);
+//     hit.asRef().map([](const std::string& s) { return s.size(); });   // no copy
+//
+// Calling the wrapper returns a copy of the cached Result, as f would.
+// view() instead pins the cached entry and lends it out: asRef() is the
+// borrowed view of Result::asRef(), valid while the MemoView lives, even
+// if the entry is evicted in the meantime.
+//
+// Ok results are kept until evicted. Errs are only kept with
+// MemoOptions::error_ttl set, and only for that long. The key is f's
+// parameter type, decayed; it needs std::hash and ==. Each shard has its
+// own mutex. f runs outside the lock, so two threads that miss on the same
+// key at once both call it, and the first result stored wins.
+//
+// Hits and misses are counted per cache (stats()) and, under
+// CPP_RUST_RESULT_METRICS, as cache_hits / cache_misses of Result<T, E>
+// in ResultMetrics::snapshot().
+struct MemoOptions {
+    std::size_t shards;                   // independent LRU lists, each with a lock
+    std::chrono::milliseconds error_ttl;  // how long an Err is reused; 0 never caches one
+
+    MemoOptions() : shards(16), error_ttl(0) {}
+};
+
+struct MemoStats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t evictions;   // entries pushed out by capacity or expiry
+    std::size_t entries;
+};
+
+// A cached Result, kept alive for as long as the view is held.
+template <typename R>
+class MemoView {
+public:
+    explicit MemoView(std::shared_ptr<const R> entry) : entry(std::move(entry)) {}
+
+    const R& result() const { return *entry; }
+    const R& operator*() const { return *entry; }
+    const R* operator->() const { return entry.get(); }
+
+    auto asRef() const -> decltype(std::declval<const R&>().asRef()) { return entry->asRef(); }
+
+private:
+    std::shared_ptr<const R> entry;
+};
+
+namespace result_detail {
+
+// the parameter and Result types of a one-argument callable
+template <typename F>
+struct MemoSignature : MemoSignature<decltype(&F::operator())> {};
+
+template <typename R, typename A>
+struct MemoSignature<R (*)(A)> {
+    typedef typename std::decay<A>::type Key;
+    typedef R Output;
+};
+
+template <typename R, typename A>
+struct MemoSignature<R (&)(A)> : MemoSignature<R (*)(A)> {};
+
+template <typename R, typename A>
+struct MemoSignature<R(A)> : MemoSignature<R (*)(A)> {};
+
+template <typename C, typename R, typename A>
+struct MemoSignature<R (C::*)(A)> : MemoSignature<R (*)(A)> {};
+
+template <typename C, typename R, typename A>
+struct MemoSignature<R (C::*)(A) const> : MemoSignature<R (*)(A)> {};
+
+template <typename Key, typename R>
+class MemoShard {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit MemoShard(std::size_t capacity) : capacity(capacity), hits(0), misses(0), evictions(0) {}
+
+    // the cached result for key, counting a hit or a miss
+    std::shared_ptr<const R> find(const Key& key, Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename Index::iterator it = index.find(key);
+        if (it != index.end()) {
+            typename Order::iterator entry = it->second;
+            if (!entry->expiring || now < entry->expires) {
+                order.splice(order.begin(), order, entry);   // most recently used first
+                ++hits;
+                return entry->value;
+            }
+            index.erase(it);
+            order.erase(entry);
+            ++evictions;
+        }
+        ++misses;
+        return std::shared_ptr<const R>();
+    }
+
+    // stores value unless another thread stored one for key first; returns the one kept
+    std::shared_ptr<const R> insert(const Key& key, std::shared_ptr<const R> value, bool expiring,
+                                    Clock::time_point expires) {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename Index::iterator it = index.find(key);
+        if (it != index.end()) return it->second->value;
+        if (order.size() >= capacity) {
+            index.erase(order.back().key);
+            order.pop_back();
+            ++evictions;
+        }
+        Entry entry = { key, std::move(value), expiring, expires };
+        order.push_front(std::move(entry));
+        index.insert(std::make_pair(key, order.begin()));
+        return order.front().value;
+    }
+
+    void addTo(MemoStats& stats) {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.hits += hits;
+        stats.misses += misses;
+        stats.evictions += evictions;
+        stats.entries += order.size();
+    }
+
+private:
+    struct Entry {
+        Key key;
+        std::shared_ptr<const R> value;
+        bool expiring;                // an Err with a TTL
+        Clock::time_point expires;
+    };
+
+    typedef std::list<Entry> Order;
+    typedef std::unordered_map<Key, typename Order::iterator> Index;
+
+    std::mutex mutex;
+    Order order;
+    Index index;
+    const std::size_t capacity;
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t evictions;
+};
+
+template <typename Key, typename R>
+struct MemoCache {
+    typedef MemoShard<Key, R> Shard;
+
+    MemoCache(std::size_t capacity, const MemoOptions& options) : error_ttl(options.error_ttl) {
+        std::size_t count = std::max<std::size_t>(1, std::min(options.shards, capacity));
+        std::size_t each = std::max<std::size_t>(1, (capacity + count - 1) / count);
+        for (std::size_t i = 0; i < count; ++i) shards.emplace_back(new Shard(each));
+    }
+
+    Shard& shardFor(const Key& key) {
+        // std::hash of an integer is often the integer; mix before reducing
+        std::uint64_t h = static_cast<std::uint64_t>(std::hash<Key>()(key)) * 0x9e3779b97f4a7c15ull;
+        return *shards[static_cast<std::size_t>(h >> 32) % shards.size()];
+    }
+
+    std::vector<std::unique_ptr<Shard> > shards;
+    std::chrono::milliseconds error_ttl;
+};
+
+} // namespace result_detail
+
+template <typename F>
+class Memoized {
+public:
+    typedef typename result_detail::MemoSignature<F>::Key Key;
+    typedef typename result_detail::MemoSignature<F>::Output Output;   // Result<T, E>
+
+    Memoized(F f, std::size_t capacity, const MemoOptions& options)
+        : f(std::move(f)), cache(std::make_shared<Cache>(capacity, options)) {}
+
+    // a copy of the cached Result for key, computing it on a miss
+    Output operator()(const Key& key) const { return *lookup(key); }
+
+    // the cached Result for key, borrowed (see above)
+    MemoView<Output> view(const Key& key) const { return MemoView<Output>(lookup(key)); }
+
+    MemoStats stats() const {
+        MemoStats out = { 0, 0, 0, 0 };
+        for (std::size_t i = 0; i < cache->shards.size(); ++i) cache->shards[i]->addTo(out);
+        return out;
+    }
+
+private:
+    typedef result_detail::MemoCache<Key, Output> Cache;
+
+    std::shared_ptr<const Output> lookup(const Key& key) const {
+        typedef std::chrono::steady_clock Clock;
+        typename Cache::Shard& shard = cache->shardFor(key);
+        Clock::time_point now = Clock::now();
+        std::shared_ptr<const Output> hit = shard.find(key, now);
+        if (hit) {
+            CPP_RUST_RESULT_COUNT(Output, ResultMetric::CacheHit);
+            return hit;
+        }
+        CPP_RUST_RESULT_COUNT(Output, ResultMetric::CacheMiss);
+        std::shared_ptr<const Output> fresh = std::make_shared<const Output>(f(key));
+        if (fresh->isOk()) return shard.insert(key, std::move(fresh), false, now);
+        if (cache->error_ttl.count() <= 0) return fresh;
+        return shard.insert(key, std::move(fresh), true, now + cache->error_ttl);
+    }
+
+    F f;
+    std::shared_ptr<Cache> cache;   // shared by copies, so andThen's by-value copy reuses it
+};
+
+// f must be pure; capacity bounds the entries across all shards (each
+// shard holds capacity / shards, rounded up)
+template <typename F>
+Memoized<typename std::decay<F>::type> memoize(F&& f, std::size_t capacity,
+                                               const MemoOptions& options = MemoOptions()) {
+    return Memoized<typename std::decay<F>::type>(std::forward<F>(f), capacity, options);
+}
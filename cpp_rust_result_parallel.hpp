@@ -0,0 +1,276 @@
+#pragma once
+#include "cpp_rust_result_collect.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+
+// ---------------------------
+// Work-stealing thread pool
+// ---------------------------
+
+// One deque per worker. A worker pops its own deque from the back (the
+// most recently pushed, still-warm task) and, when that is empty, steals
+// from the front of the others. Tasks submitted from a worker go to its own
+// deque, the rest are spread round-robin. Any thread can help through
+// runPending(), which is how a thread waiting on the pool avoids idling
+// (and deadlocking when it is itself a worker).
+//
+//     WorkStealingPool pool;                     // hardware_concurrency workers
+//     auto rows = parallelTraverse(records, validateRecord, pool);
+class WorkStealingPool {
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()> > tasks;
+    };
+
+public:
+    explicit WorkStealingPool(std::size_t threads = std::thread::hardware_concurrency())
+        : queued(0), next(0), stopping(false) {
+        threads = std::max<std::size_t>(threads, 1);
+        for (std::size_t i = 0; i < threads; ++i) queues.emplace_back(new Queue());
+        for (std::size_t i = 0; i < threads; ++i) workers.emplace_back(&WorkStealingPool::run, this, i);
+    }
+
+    // runs every task already submitted, then joins the workers
+    ~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    }
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    std::size_t size() const { return workers.size(); }
+
+    void submit(std::function<void()> task) {
+        std::size_t self = workerIndex();
+        std::size_t target = self < queues.size() ? self
+                                                  : next.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(std::move(task));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+
+    // runs one queued task on the calling thread; false when none is queued
+    bool runPending() {
+        std::function<void()> task;
+        if (!take(workerIndex(), task)) return false;
+        task();
+        return true;
+    }
+
+private:
+    // this thread's index in the pool, or size() for outside threads
+    std::size_t workerIndex() const {
+        return current().pool == this ? current().index : queues.size();
+    }
+
+    struct Current {
+        const WorkStealingPool* pool;
+        std::size_t index;
+    };
+
+    static Current& current() {
+        static thread_local Current worker = { nullptr, 0 };
+        return worker;
+    }
+
+    bool take(std::size_t self, std::function<void()>& task) {
+        if (queued.load(std::memory_order_acquire) == 0) return false;
+        std::size_t count = queues.size();
+        if (self < count) {
+            Queue& own = *queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                queued.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        std::size_t start = self < count ? self + 1 : 0;
+        for (std::size_t k = 0; k < count; ++k) {
+            Queue& victim = *queues[(start + k) % count];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    }
+
+    void run(std::size_t self) {
+        current().pool = this;
+        current().index = self;
+        for (;;) {
+            std::function<void()> task;
+            if (take(self, task)) {
+                task();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> queued;
+    std::atomic<std::size_t> next;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+};
+
+// ---------------------------
+// Parallel traverse
+// ---------------------------
+namespace result_detail {
+
+// One call's shared state. Each chunk writes the Results of its indices
+// into preallocated slots, so workers never contend on the output; the
+// caller assembles the vector once every chunk has finished.
+template <typename It, typename F>
+class ParallelJob {
+    typedef typename std::decay<decltype(std::declval<F&>()(*std::declval<It&>()))>::type Item;
+    typedef typename std::aligned_storage<sizeof(Item), alignof(Item)>::type Slot;
+    typedef CollectTypes<Item> Types;
+
+public:
+    ParallelJob(It first, std::size_t count, F& f, bool fail_fast)
+        : first(first), count(count), f(f), fail_fast(fail_fast),
+          slots(new Slot[count]), built(new bool[count]()), cancelled(false), remaining(0) {}
+
+    ~ParallelJob() {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (built[i]) item(i).~Item();
+        }
+    }
+
+    ParallelJob(const ParallelJob&) = delete;
+    ParallelJob& operator=(const ParallelJob&) = delete;
+
+    void run(WorkStealingPool& pool, std::size_t grain) {
+        if (grain == 0) grain = std::max<std::size_t>(1, count / (pool.size() * 8));
+        remaining = (count + grain - 1) / grain;
+        for (std::size_t begin = 0; begin < count; begin += grain) {
+            std::size_t end = std::min(count, begin + grain);
+            pool.submit([this, begin, end] { runChunk(begin, end); });
+        }
+        // help instead of blocking a thread the pool may need
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (remaining == 0) return;
+            }
+            if (pool.runPending()) continue;
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&] { return remaining == 0; });
+            return;
+        }
+    }
+
+    // the lowest-indexed Err among the elements evaluated
+    typename Types::First takeFirst() {
+        std::vector<typename Types::Value> values;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (built[i] && !TryAccess::ok(item(i))) return TryAccess::error(std::move(item(i)));
+        }
+        values.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) values.emplace_back(TryAccess::value(std::move(item(i))));
+        return Types::First::Ok(std::move(values));
+    }
+
+    typename Types::All takeAll() {
+        std::vector<typename Types::Error> errors;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (!TryAccess::ok(item(i))) errors.emplace_back(TryAccess::error(std::move(item(i))).get());
+        }
+        if (!errors.empty()) return Types::All::Err(std::move(errors));
+        std::vector<typename Types::Value> values;
+        values.reserve(count);
+        for (std::size_t i = 0; i < count; ++i) values.emplace_back(TryAccess::value(std::move(item(i))));
+        return Types::All::Ok(std::move(values));
+    }
+
+private:
+    Item& item(std::size_t i) { return *reinterpret_cast<Item*>(&slots[i]); }
+
+    void runChunk(std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            if (cancelled.load(std::memory_order_relaxed)) break;
+            new (&slots[i]) Item(f(first[i]));
+            built[i] = true;
+            if (fail_fast && !TryAccess::ok(item(i))) cancelled.store(true, std::memory_order_relaxed);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remaining == 0) done.notify_all();
+    }
+
+    It first;
+    const std::size_t count;
+    F& f;
+    const bool fail_fast;
+    std::unique_ptr<Slot[]> slots;
+    std::unique_ptr<bool[]> built;   // one writer per index, read after the join
+    std::atomic<bool> cancelled;
+    std::size_t remaining;           // chunks not yet finished, under mutex
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+template <typename Range>
+struct ParallelRange {
+    typedef typename RangeIter<Range>::type It;
+    static_assert(std::is_base_of<std::random_access_iterator_tag,
+                                  typename std::iterator_traits<It>::iterator_category>::value,
+                  "parallelTraverse needs a random-access range");
+};
+
+} // namespace result_detail
+
+// traverse(range, f) with f run on the pool's workers, grain elements per
+// task (0 picks about eight tasks per worker). The first Err cancels the
+// chunks that have not started yet through a shared flag; the Err returned
+// is the lowest-indexed one among the elements evaluated. f is called
+// concurrently and must be safe to call from several threads.
+template <typename Range, typename F>
+typename result_detail::TraverseTypes<typename result_detail::ParallelRange<Range>::It, F>::First
+parallelTraverse(Range&& range, F f, WorkStealingPool& pool, std::size_t grain = 0) {
+    typedef result_detail::RangeIter<Range> Iter;
+    typename Iter::type first = Iter::make(std::begin(range));
+    std::size_t count = static_cast<std::size_t>(std::distance(std::begin(range), std::end(range)));
+    result_detail::ParallelJob<typename Iter::type, F> job(first, count, f, true);
+    job.run(pool, grain);
+    return job.takeFirst();
+}
+
+// every element is evaluated; the Errs come back in input order
+template <typename Range, typename F>
+typename result_detail::TraverseTypes<typename result_detail::ParallelRange<Range>::It, F>::All
+parallelTraverseAll(Range&& range, F f, WorkStealingPool& pool, std::size_t grain = 0) {
+    typedef result_detail::RangeIter<Range> Iter;
+    typename Iter::type first = Iter::make(std::begin(range));
+    std::size_t count = static_cast<std::size_t>(std::distance(std::begin(range), std::end(range)));
+    result_detail::ParallelJob<typename Iter::type, F> job(first, count, f, false);
+    job.run(pool, grain);
+    return job.takeAll();
+}
@@ -0,0 +1,180 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <cstddef>
+#include <tuple>
+
+// ---------------------------
+// Fused pipelines
+// ---------------------------
+//
+// pipeline() records map/andThen stages in its type and runs them in one
+// pass when applied to a Result, building only the final Result:
+//
+//     static const auto process = pipeline()
+//         .andThen(parseInput)
+//         .map([](const std::string& s) { return static_cast<double>(s.size()); })
+//         .andThen(checkRange);
+//     Result<double, std::string> r = process(readFile(path));
+//
+// Each stage receives the previous value as an xvalue (the source's value
+// as an lvalue when the source is one), so a stage taking const& or &&
+// sees it without a copy or a move; a stage that returns a
+// reference passes the referenced object on as is. An Err from the source
+// or an andThen stage skips the remaining stages. The final error type is
+// the source's; andThen stages may return any error convertible to it.
+namespace result_detail {
+
+template <typename F>
+struct PipeMap {
+    F f;
+
+    // the stage's output, as handed to the next stage
+    template <typename V>
+    struct Output {
+        typedef decltype(std::declval<const F&>()(std::declval<V>())) type;
+    };
+
+    template <typename Out, typename V, typename Next>
+    Out apply(V&& value, const Next& next) const {
+        auto&& mapped = f(std::forward<V>(value));
+        return next(static_cast<decltype(mapped)&&>(mapped));
+    }
+};
+
+template <typename F>
+struct PipeAndThen {
+    F f;
+
+    template <typename V>
+    struct Output {
+        typedef typename std::decay<decltype(std::declval<const F&>()(std::declval<V>()))>::type Step;
+        typedef decltype(TryAccess::value(std::declval<Step&&>())) type;
+    };
+
+    template <typename Out, typename V, typename Next>
+    Out apply(V&& value, const Next& next) const {
+        auto&& step = f(std::forward<V>(value));
+        if (!CPP_RUST_RESULT_LIKELY(TryAccess::ok(step))) {
+            return TryAccess::error(static_cast<decltype(step)&&>(step));
+        }
+        return next(TryAccess::value(static_cast<decltype(step)&&>(step)));
+    }
+};
+
+// value type after stages [I, N) starting from a V
+template <std::size_t I, std::size_t N, typename Stages, typename V>
+struct PipeValue {
+    typedef typename std::tuple_element<I, Stages>::type Stage;
+    typedef typename PipeValue<I + 1, N, Stages,
+                               typename Stage::template Output<V>::type>::type type;
+};
+
+template <std::size_t N, typename Stages, typename V>
+struct PipeValue<N, N, Stages, V> {
+    typedef typename std::decay<V>::type type;
+};
+
+template <typename Source>
+struct PipeSource;
+
+template <typename T, typename E>
+struct PipeSource<Result<T, E> > {
+    static_assert(!std::is_void<T>::value, "pipeline needs a value payload");
+    typedef T Value;
+    typedef E Error;
+};
+
+} // namespace result_detail
+
+template <typename... Stages>
+class Pipeline {
+    typedef std::tuple<Stages...> Tuple;
+    static const std::size_t count = sizeof...(Stages);
+
+    template <typename... Other>
+    friend class Pipeline;
+    friend Pipeline<> pipeline();
+
+    Tuple stages;
+
+    Pipeline() {}
+    explicit Pipeline(Tuple&& stages) : stages(std::move(stages)) {}
+
+    template <typename Stage>
+    Pipeline<Stages..., Stage> append(Stage&& stage) const& {
+        return Pipeline<Stages..., Stage>(std::tuple_cat(stages, std::make_tuple(std::move(stage))));
+    }
+    template <typename Stage>
+    Pipeline<Stages..., Stage> append(Stage&& stage) && {
+        return Pipeline<Stages..., Stage>(std::tuple_cat(std::move(stages), std::make_tuple(std::move(stage))));
+    }
+
+    template <typename R>
+    struct Run {
+        typedef result_detail::PipeSource<typename std::decay<R>::type> Source;
+        typedef decltype(result_detail::TryAccess::value(std::declval<R>())) First;
+        typedef Result<typename result_detail::PipeValue<0, count, Tuple, First>::type,
+                       typename Source::Error> Out;
+    };
+
+    // the continuation of stage I - 1: runs stages [I, N)
+    template <std::size_t I, typename Out>
+    struct Next {
+        const Pipeline* self;
+
+        template <typename V>
+        Out operator()(V&& value) const {
+            return self->template runFrom<I, Out>(std::forward<V>(value),
+                                                  std::integral_constant<bool, I == count>());
+        }
+    };
+
+    template <std::size_t I, typename Out, typename V>
+    Out runFrom(V&& value, std::true_type) const {
+        return Out::Ok(std::forward<V>(value));
+    }
+
+    template <std::size_t I, typename Out, typename V>
+    Out runFrom(V&& value, std::false_type) const {
+        Next<I + 1, Out> next = { this };
+        return std::get<I>(stages).template apply<Out>(std::forward<V>(value), next);
+    }
+
+    template <typename Out, typename R>
+    Out run(R&& source) const {
+        if (!CPP_RUST_RESULT_LIKELY(result_detail::TryAccess::ok(source))) {
+            return result_detail::TryAccess::error(std::forward<R>(source));
+        }
+        Next<0, Out> first = { this };
+        return first(result_detail::TryAccess::value(std::forward<R>(source)));
+    }
+
+public:
+    // f(value) -> U
+    template <typename F>
+    Pipeline<Stages..., result_detail::PipeMap<F> > map(F f) const& {
+        return append(result_detail::PipeMap<F>{ std::move(f) });
+    }
+    template <typename F>
+    Pipeline<Stages..., result_detail::PipeMap<F> > map(F f) && {
+        return std::move(*this).append(result_detail::PipeMap<F>{ std::move(f) });
+    }
+
+    // f(value) -> Result<U, E2>
+    template <typename F>
+    Pipeline<Stages..., result_detail::PipeAndThen<F> > andThen(F f) const& {
+        return append(result_detail::PipeAndThen<F>{ std::move(f) });
+    }
+    template <typename F>
+    Pipeline<Stages..., result_detail::PipeAndThen<F> > andThen(F f) && {
+        return std::move(*this).append(result_detail::PipeAndThen<F>{ std::move(f) });
+    }
+
+    // an rvalue source is consumed, an lvalue one is passed on as an lvalue
+    template <typename R>
+    typename Run<R&&>::Out operator()(R&& source) const {
+        return run<typename Run<R&&>::Out>(std::forward<R>(source));
+    }
+};
+
+inline Pipeline<> pipeline() { return Pipeline<>(); }
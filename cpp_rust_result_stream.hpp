@@ -0,0 +1,548 @@
+#pragma once
+#include "cpp_rust_result_io.hpp"
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+
+// ---------------------------
+// Chunked streams
+// ---------------------------
+//
+// streamFile(path) yields a file as a sequence of Result<Chunk, IoError>,
+// each chunk a view of one buffer from a small fixed pool, so an input of
+// any size is processed in constant memory. map/andThen build the rest of
+// the pipeline lazily, one chunk at a time:
+//
+//     auto counts = streamFile(path)
+//         .andThen(parseChunk)                                  // Result<Records, IoError>
+//         .map([](const Records& r) { return r.size(); });
+//
+//     for (auto& n : counts) {                                  // Result<std::size_t, IoError>&
+//         if (n.isErr()) return report(n.unwrapErr());
+//         total += n.unwrap();
+//     }
+//
+// With read_ahead (the default) a background thread reads the next chunk
+// while the current one is processed; with two buffers that is double
+// buffering. A read error is yielded once, as an Err, and ends the stream.
+// An Err from an andThen step only replaces its own chunk.
+//
+// A chunk returns its buffer to the pool when it is destroyed. Keep at most
+// buffers - 1 chunks beyond the current iteration. A next() with every
+// buffer held yields Err(ENOBUFS) rather than waiting forever.
+struct StreamOptions {
+    std::size_t chunk_size;   // bytes per buffer
+    std::size_t buffers;      // the pool; at least 2 for read-ahead to overlap
+    bool read_ahead;          // read on a background thread
+
+    StreamOptions() : chunk_size(64 * 1024), buffers(2), read_ahead(true) {}
+};
+
+namespace result_detail {
+class ChunkChannel;
+}
+
+// One buffer of input: the bytes read, and where they start in the stream.
+// Move-only; the buffer goes back to the pool in the destructor.
+class Chunk {
+public:
+    Chunk(Chunk&& other) noexcept
+        : channel(std::move(other.channel)), buffer(other.buffer), bytes(other.bytes), length(other.length),
+          start(other.start) {}
+
+    Chunk& operator=(Chunk&& other) noexcept {
+        if (this != &other) {
+            release();
+            channel = std::move(other.channel);
+            buffer = other.buffer;
+            bytes = other.bytes;
+            length = other.length;
+            start = other.start;
+        }
+        return *this;
+    }
+
+    Chunk(const Chunk&) = delete;
+    Chunk& operator=(const Chunk&) = delete;
+
+    ~Chunk() { release(); }
+
+    const char* data() const { return bytes; }
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    std::uint64_t offset() const { return start; }
+
+    const char* begin() const { return bytes; }
+    const char* end() const { return bytes + length; }
+
+    // an owned copy
+    std::string str() const { return std::string(bytes, length); }
+
+private:
+    friend class result_detail::ChunkChannel;
+
+    Chunk(std::shared_ptr<result_detail::ChunkChannel> channel, std::size_t buffer, const char* bytes,
+          std::size_t length, std::uint64_t start)
+        : channel(std::move(channel)), buffer(buffer), bytes(bytes), length(length), start(start) {}
+
+    void release();
+
+    std::shared_ptr<result_detail::ChunkChannel> channel;   // null once moved from
+    std::size_t buffer;
+    const char* bytes;
+    std::size_t length;
+    std::uint64_t start;
+};
+
+namespace result_detail {
+
+// Room for one element, filled and emptied in place, so pulling through a
+// pipeline allocates nothing per chunk.
+template <typename R>
+class StreamSlot {
+public:
+    StreamSlot() : full(false) {}
+    StreamSlot(const StreamSlot&) = delete;
+    StreamSlot& operator=(const StreamSlot&) = delete;
+    ~StreamSlot() { reset(); }
+
+    template <typename... Args>
+    void emplace(Args&&... args) {
+        reset();
+        new (&storage) R(std::forward<Args>(args)...);
+        full = true;
+    }
+
+    void reset() {
+        if (full) get().~R();
+        full = false;
+    }
+
+    bool has() const { return full; }
+    R& get() { return *reinterpret_cast<R*>(&storage); }
+
+private:
+    typename std::aligned_storage<sizeof(R), std::alignment_of<R>::value>::type storage;
+    bool full;
+};
+
+// one stage of a stream: fills out and returns true, or returns false at the end
+template <typename R>
+class StreamProducer {
+public:
+    virtual ~StreamProducer() {}
+    virtual bool next(StreamSlot<R>& out) = 0;
+};
+
+// Where chunk bytes come from. Regular files are read until a buffer is
+// full; anything else (a pipe, a socket) hands over what one read returns.
+class ChunkSource {
+public:
+#if defined(_WIN32)
+    ChunkSource(std::FILE* file, std::string name) : file(file), name(std::move(name)) {}
+    ~ChunkSource() { std::fclose(file); }
+
+    // bytes read into buffer; 0 at the end; false with errno set on failure
+    bool read(char* buffer, std::size_t capacity, std::size_t& got) {
+        got = std::fread(buffer, 1, capacity, file);
+        return !std::ferror(file);
+    }
+#else
+    ChunkSource(int fd, bool owned, std::string name) : fd(fd), owned(owned), fill(false), name(std::move(name)) {
+        struct stat info;
+        fill = ::fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+    }
+    ~ChunkSource() {
+        if (owned) ::close(fd);
+    }
+
+    // bytes read into buffer; 0 at the end; false with errno set on failure
+    bool read(char* buffer, std::size_t capacity, std::size_t& got) {
+        got = 0;
+        while (got < capacity) {
+            ssize_t n = ::read(fd, buffer + got, capacity - got);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            if (n == 0) break;
+            got += static_cast<std::size_t>(n);
+            if (!fill) break;
+        }
+        return true;
+    }
+#endif
+
+    ChunkSource(const ChunkSource&) = delete;
+    ChunkSource& operator=(const ChunkSource&) = delete;
+
+    const std::string& path() const { return name; }
+
+private:
+#if defined(_WIN32)
+    std::FILE* file;
+#else
+    int fd;
+    bool owned;
+    bool fill;   // a regular file: loop until the buffer is full
+#endif
+    std::string name;
+};
+
+// The buffer pool and the hand-off between the reader and the consumer.
+// Shared by the stream, the reader thread and every live Chunk.
+class ChunkChannel : public std::enable_shared_from_this<ChunkChannel> {
+public:
+    ChunkChannel(std::unique_ptr<ChunkSource> source, const StreamOptions& options)
+        : source(std::move(source)), chunk_size(options.chunk_size ? options.chunk_size : 1),
+          buffers(options.buffers ? options.buffers : 1), memory(new char[chunk_size * buffers]),
+          ready(buffers), ready_head(0), ready_count(0), held(0), position(0),
+          finished(false), failed(false), reported(false), stopping(false), error() {
+        free_list.reserve(buffers);
+        for (std::size_t i = buffers; i-- > 0;) free_list.push_back(i);
+    }
+
+    ChunkChannel(const ChunkChannel&) = delete;
+    ChunkChannel& operator=(const ChunkChannel&) = delete;
+
+    // reader thread body: fill free buffers until the end, an error or stop()
+    void readAhead() {
+        while (fillOne(true)) {}
+    }
+
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        buffer_freed.notify_all();
+    }
+
+    // the consumer side; inline_reads when there is no reader thread
+    bool next(StreamSlot<Result<Chunk, IoError> >& out, bool inline_reads) {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            if (ready_count) {
+                Filled filled = ready[ready_head];
+                ready_head = (ready_head + 1) % buffers;
+                --ready_count;
+                ++held;
+                lock.unlock();
+                out.emplace(Result<Chunk, IoError>::Ok(Chunk(shared_from_this(), filled.buffer,
+                                                             memory.get() + filled.buffer * chunk_size, filled.size,
+                                                             filled.start)));
+                return true;
+            }
+            if (failed && !reported) {
+                reported = true;
+                out.emplace(Result<Chunk, IoError>::Err(error));
+                return true;
+            }
+            if (finished || failed) return false;
+            if (held == buffers) {
+                IoError exhausted = { ENOBUFS, "read", source->path() };
+                out.emplace(Result<Chunk, IoError>::Err(std::move(exhausted)));
+                return true;
+            }
+            if (inline_reads) {
+                lock.unlock();
+                fillOne(false);
+                lock.lock();
+            } else {
+                chunk_ready.wait(lock);
+            }
+        }
+    }
+
+    void release(std::size_t buffer) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_list.push_back(buffer);
+            --held;
+        }
+        buffer_freed.notify_one();
+    }
+
+private:
+    struct Filled {
+        std::size_t buffer;
+        std::size_t size;
+        std::uint64_t start;
+    };
+
+    // reads one buffer's worth; false once there is nothing more to read
+    bool fillOne(bool wait_for_buffer) {
+        std::size_t buffer;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wait_for_buffer) {
+                while (free_list.empty() && !stopping) buffer_freed.wait(lock);
+            }
+            if (stopping || free_list.empty()) return false;
+            buffer = free_list.back();
+            free_list.pop_back();
+        }
+        std::size_t got = 0;
+        bool ok = source->read(memory.get() + buffer * chunk_size, chunk_size, got);
+        int code = errno;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok || got == 0) {
+                free_list.push_back(buffer);
+                if (ok) finished = true;
+                else {
+                    failed = true;
+                    IoError failure = { code, "read", source->path() };
+                    error = std::move(failure);
+                }
+            } else {
+                Filled filled = { buffer, got, position };
+                ready[(ready_head + ready_count) % buffers] = filled;
+                ++ready_count;
+                position += got;
+            }
+        }
+        chunk_ready.notify_one();
+        return ok && got != 0;
+    }
+
+    std::unique_ptr<ChunkSource> source;
+    const std::size_t chunk_size;
+    const std::size_t buffers;
+    std::unique_ptr<char[]> memory;   // buffers * chunk_size, allocated once
+
+    std::mutex mutex;
+    std::condition_variable chunk_ready;
+    std::condition_variable buffer_freed;
+    std::vector<std::size_t> free_list;
+    std::vector<Filled> ready;        // ring of filled buffers, oldest at ready_head
+    std::size_t ready_head;
+    std::size_t ready_count;
+    std::size_t held;                 // buffers owned by live Chunks
+    std::uint64_t position;
+    bool finished;
+    bool failed;
+    bool reported;
+    bool stopping;
+    IoError error;
+};
+
+// the stream's first stage, and the owner of the reader thread
+class ChunkProducer : public StreamProducer<Result<Chunk, IoError> > {
+public:
+    ChunkProducer(std::unique_ptr<ChunkSource> source, const StreamOptions& options)
+        : channel(std::make_shared<ChunkChannel>(std::move(source), options)), read_ahead(options.read_ahead) {
+        if (read_ahead) reader = std::thread(&ChunkChannel::readAhead, channel);
+    }
+
+    // a reader blocked in read() on a socket is only released by the peer
+    // or a shutdown() of the socket
+    ~ChunkProducer() {
+        channel->stop();
+        if (reader.joinable()) reader.join();
+    }
+
+    bool next(StreamSlot<Result<Chunk, IoError> >& out) override { return channel->next(out, !read_ahead); }
+
+private:
+    std::shared_ptr<ChunkChannel> channel;
+    bool read_ahead;
+    std::thread reader;
+};
+
+// the stream of a file that could not be opened: one Err, then the end
+class FailedOpen : public StreamProducer<Result<Chunk, IoError> > {
+public:
+    FailedOpen(int code, const std::string& path) : error(), done(false) {
+        error.code = code;
+        error.operation = "open";
+        error.path = path;
+    }
+
+    bool next(StreamSlot<Result<Chunk, IoError> >& out) override {
+        if (done) return false;
+        done = true;
+        out.emplace(Result<Chunk, IoError>::Err(std::move(error)));
+        return true;
+    }
+
+private:
+    IoError error;
+    bool done;
+};
+
+// a later stage: pulls one element from inner and applies step to it
+template <typename In, typename Out, typename Step>
+class StepProducer : public StreamProducer<Out> {
+public:
+    StepProducer(std::unique_ptr<StreamProducer<In> > inner, Step step)
+        : inner(std::move(inner)), step(std::move(step)) {}
+
+    bool next(StreamSlot<Out>& out) override {
+        if (!inner->next(input)) return false;
+        out.emplace(step(std::move(input.get())));
+        input.reset();   // the input's chunk is released before the next pull
+        return true;
+    }
+
+private:
+    std::unique_ptr<StreamProducer<In> > inner;
+    Step step;
+    StreamSlot<In> input;
+};
+
+template <typename F>
+struct StreamMap {
+    F f;
+
+    template <typename R>
+    auto operator()(R&& r) -> decltype(std::move(r).map(std::ref(f))) { return std::move(r).map(std::ref(f)); }
+};
+
+template <typename F>
+struct StreamAndThen {
+    F f;
+
+    template <typename R>
+    auto operator()(R&& r) -> decltype(std::move(r).andThen(std::ref(f))) { return std::move(r).andThen(std::ref(f)); }
+};
+
+template <typename R>
+struct StreamOf;
+
+} // namespace result_detail
+
+// A lazy, single-pass sequence of Result<T, E>. Move-only; iterating it
+// consumes it. The element an iterator points at lives until the
+// iterator is advanced.
+template <typename T, typename E>
+class ResultStream {
+public:
+    typedef Result<T, E> value_type;
+    typedef result_detail::StreamProducer<value_type> Producer;
+
+    explicit ResultStream(std::unique_ptr<Producer> producer) : producer(std::move(producer)) {}
+
+    // only the rest of the stream moves; an element already pulled stays behind
+    ResultStream(ResultStream&& other) : producer(std::move(other.producer)) {}
+
+    ResultStream& operator=(ResultStream&& other) {
+        current.reset();
+        producer = std::move(other.producer);
+        return *this;
+    }
+
+    class iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef Result<T, E> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator() : stream(nullptr) {}
+
+        reference operator*() const { return stream->current.get(); }
+        pointer operator->() const { return &stream->current.get(); }
+
+        iterator& operator++() {
+            if (!stream->pull()) stream = nullptr;
+            return *this;
+        }
+
+        friend bool operator==(const iterator& a, const iterator& b) { return a.stream == b.stream; }
+        friend bool operator!=(const iterator& a, const iterator& b) { return a.stream != b.stream; }
+
+    private:
+        friend class ResultStream;
+        explicit iterator(ResultStream* stream) : stream(stream) {}
+
+        ResultStream* stream;
+    };
+
+    // pulls the first element
+    iterator begin() { return pull() ? iterator(this) : iterator(); }
+    iterator end() { return iterator(); }
+
+    // the next element, or nullptr at the end; valid until the next call
+    value_type* next() { return pull() ? &current.get() : nullptr; }
+
+    // f(T) for each Ok element
+    template <typename F>
+    auto map(F f) && -> typename result_detail::StreamOf<
+        decltype(std::declval<value_type&&>().map(std::ref(f)))>::type {
+        return then<result_detail::StreamMap<F> >(std::move(f));
+    }
+
+    // f(T) -> Result<U, E> for each Ok element; an Err replaces that element only
+    template <typename F>
+    auto andThen(F f) && -> typename result_detail::StreamOf<
+        decltype(std::declval<value_type&&>().andThen(std::ref(f)))>::type {
+        return then<result_detail::StreamAndThen<F> >(std::move(f));
+    }
+
+private:
+    template <typename Step, typename F>
+    auto then(F f) -> typename result_detail::StreamOf<decltype(std::declval<Step&>()(std::declval<value_type&&>()))>::type {
+        typedef decltype(std::declval<Step&>()(std::declval<value_type&&>())) Out;
+        typedef typename result_detail::StreamOf<Out>::type Next;
+        Step step = { std::move(f) };
+        std::unique_ptr<typename Next::Producer> stage(
+            new result_detail::StepProducer<value_type, Out, Step>(std::move(producer), std::move(step)));
+        return Next(std::move(stage));
+    }
+
+    bool pull() {
+        current.reset();   // releases the previous element's chunk first
+        return producer && producer->next(current);
+    }
+
+    std::unique_ptr<Producer> producer;
+    result_detail::StreamSlot<value_type> current;
+};
+
+namespace result_detail {
+
+template <typename T, typename E>
+struct StreamOf<Result<T, E> > {
+    typedef ResultStream<T, E> type;
+};
+
+} // namespace result_detail
+
+inline void Chunk::release() {
+    if (channel) channel->release(buffer);
+    channel.reset();
+}
+
+// The chunks of the file at path. An open failure is the stream's only element.
+inline ResultStream<Chunk, IoError> streamFile(const std::string& path, const StreamOptions& options = StreamOptions()) {
+    typedef ResultStream<Chunk, IoError> Stream;
+#if defined(_WIN32)
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return Stream(std::unique_ptr<Stream::Producer>(new result_detail::FailedOpen(errno, path)));
+    std::unique_ptr<result_detail::ChunkSource> source(new result_detail::ChunkSource(file, path));
+#else
+    int fd = result_detail::openReadOnly(path);
+    if (fd < 0) return Stream(std::unique_ptr<Stream::Producer>(new result_detail::FailedOpen(errno, path)));
+    std::unique_ptr<result_detail::ChunkSource> source(new result_detail::ChunkSource(fd, true, path));
+#endif
+    return Stream(std::unique_ptr<Stream::Producer>(new result_detail::ChunkProducer(std::move(source), options)));
+}
+
+#if !defined(_WIN32)
+// The chunks read from an open descriptor: a socket, a pipe, stdin. The
+// descriptor is not closed; name only labels errors.
+inline ResultStream<Chunk, IoError> streamFd(int fd, const StreamOptions& options = StreamOptions(),
+                                             const std::string& name = "fd") {
+    typedef ResultStream<Chunk, IoError> Stream;
+    std::unique_ptr<result_detail::ChunkSource> source(new result_detail::ChunkSource(fd, false, name));
+    return Stream(std::unique_ptr<Stream::Producer>(new result_detail::ChunkProducer(std::move(source), options)));
+}
+#endif
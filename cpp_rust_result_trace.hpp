@@ -0,0 +1,331 @@
+#pragma once
+#include "cpp_rust_result.hpp"
+#include <cstdint>
+#if defined(CPP_RUST_RESULT_TRACING)
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <ostream>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CPP_RUST_RESULT_TRACE_TSC 1
+#endif
+#endif
+
+// ---------------------------
+// Stage latency tracing
+// ---------------------------
+//
+// traced(RESULT_STAGE("parse"), f) wraps a map/andThen/orElse step, or a
+// pipeline() stage, so that each call records its start, its duration and
+// whether it produced an Err into a per-thread buffer:
+//
+//     auto value = readFile(path)
+//         .andThen(traced(RESULT_STAGE("parse"), parseInput))
+//         .map(traced(RESULT_STAGE("measure"), measure));
+//
+//     static TraceHistograms histograms;
+//     ResultTrace::flushTo(histograms);   // from the thread that recorded
+//     histograms.write(std::cout);        // count, Err count, p50/p99/max per stage
+//
+// Tracing is compiled in only with CPP_RUST_RESULT_TRACING defined. Without
+// it traced() hands back f itself and RESULT_STAGE is a null pointer, so
+// the instrumented code is the code that was there before.
+struct TraceStage {
+    const char* name;
+};
+
+#if defined(CPP_RUST_RESULT_TRACING)
+// the TraceStage of this line; literal must be a string literal
+#define RESULT_STAGE(literal) \
+    ([]() -> const ::TraceStage* { static const ::TraceStage stage = { literal }; return &stage; }())
+
+namespace result_detail {
+
+// Ticks of the cheapest monotonic clock: the TSC where there is one (about
+// 20 cycles to read), steady_clock nanoseconds elsewhere. nanosPerTick()
+// calibrates the TSC against steady_clock over the time since first use.
+struct TraceClock {
+    static std::uint64_t now() {
+#if defined(CPP_RUST_RESULT_TRACE_TSC)
+        return __rdtsc();
+#else
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    static double nanosPerTick() {
+#if defined(CPP_RUST_RESULT_TRACE_TSC)
+        static const Origin origin = Origin::take();
+        Origin current = Origin::take();
+        std::chrono::duration<double, std::nano> elapsed = current.time - origin.time;
+        if (current.ticks <= origin.ticks || elapsed.count() < 1e6) return calibrateShort();
+        return elapsed.count() / static_cast<double>(current.ticks - origin.ticks);
+#else
+        return 1.0;
+#endif
+    }
+
+private:
+#if defined(CPP_RUST_RESULT_TRACE_TSC)
+    struct Origin {
+        std::uint64_t ticks;
+        std::chrono::steady_clock::time_point time;
+
+        static Origin take() {
+            Origin origin = { now(), std::chrono::steady_clock::now() };
+            return origin;
+        }
+    };
+
+    // under a millisecond since first use: spin for one to get a ratio
+    static double calibrateShort() {
+        Origin start = Origin::take();
+        Origin end = start;
+        while (end.time - start.time < std::chrono::milliseconds(1)) end = Origin::take();
+        std::chrono::duration<double, std::nano> elapsed = end.time - start.time;
+        return elapsed.count() / static_cast<double>(end.ticks - start.ticks);
+    }
+#endif
+};
+
+struct TraceEvent {
+    const TraceStage* stage;
+    std::uint64_t start;
+    std::uint64_t ticks;
+    bool ok;
+};
+
+// Fixed per-thread buffer (32 KiB), trivially destructible. When it fills
+// up the oldest events are overwritten and counted as dropped.
+struct TraceBuffer {
+    static const std::size_t capacity = 1024;
+
+    TraceEvent events[capacity];
+    std::uint64_t written;   // total events recorded; the last capacity are kept
+    std::uint64_t flushed;   // written at the last flush
+
+    static TraceBuffer& local() {
+        static thread_local TraceBuffer buffer;
+        return buffer;
+    }
+
+    void record(const TraceStage* stage, std::uint64_t start, std::uint64_t end, bool ok) {
+        TraceEvent& event = events[written % capacity];
+        event.stage = stage;
+        event.start = start;
+        event.ticks = end - start;
+        event.ok = ok;
+        ++written;
+    }
+};
+
+// what counts as an Err for a stage's return value
+template <typename R>
+struct TraceOutcome {
+    static bool ok(const R&) { return true; }
+};
+
+template <typename T, typename E>
+struct TraceOutcome<Result<T, E> > {
+    static bool ok(const Result<T, E>& result) { return TryAccess::ok(result); }
+};
+
+// Times one call of f and returns exactly what f returns: a value, a
+// reference (bound, never copied) or nothing.
+template <typename Out>
+struct TracedCall {
+    template <typename F, typename... Args>
+    static Out run(const TraceStage* stage, const F& f, Args&&... args) {
+        std::uint64_t start = TraceClock::now();
+        Out out = f(std::forward<Args>(args)...);
+        TraceBuffer::local().record(stage, start, TraceClock::now(),
+                                    TraceOutcome<typename std::decay<Out>::type>::ok(out));
+        return out;
+    }
+};
+
+template <typename Out>
+struct TracedCall<Out&&> {
+    template <typename F, typename... Args>
+    static Out&& run(const TraceStage* stage, const F& f, Args&&... args) {
+        std::uint64_t start = TraceClock::now();
+        Out&& out = f(std::forward<Args>(args)...);
+        TraceBuffer::local().record(stage, start, TraceClock::now(),
+                                    TraceOutcome<typename std::decay<Out>::type>::ok(out));
+        return static_cast<Out&&>(out);
+    }
+};
+
+template <>
+struct TracedCall<void> {
+    template <typename F, typename... Args>
+    static void run(const TraceStage* stage, const F& f, Args&&... args) {
+        std::uint64_t start = TraceClock::now();
+        f(std::forward<Args>(args)...);
+        TraceBuffer::local().record(stage, start, TraceClock::now(), true);
+    }
+};
+
+template <typename F>
+struct Traced {
+    const TraceStage* stage;
+    F f;
+
+    template <typename... Args>
+    auto operator()(Args&&... args) const -> decltype(std::declval<const F&>()(std::forward<Args>(args)...)) {
+        typedef decltype(std::declval<const F&>()(std::forward<Args>(args)...)) Out;
+        return TracedCall<Out>::run(stage, f, std::forward<Args>(args)...);
+    }
+};
+
+} // namespace result_detail
+
+// Per-stage latency histograms, fed by ResultTrace::flushTo. Buckets are
+// powers of two of nanoseconds; safe to share between flushing threads.
+class TraceHistograms {
+public:
+    static const std::size_t buckets = 40;
+
+    struct Stage {
+        std::uint64_t count;
+        std::uint64_t errors;
+        std::uint64_t max_ns;
+        std::uint64_t histogram[buckets];   // [i]: durations in [2^i, 2^(i+1)) ns
+
+        // upper bound of the bucket holding quantile q
+        std::uint64_t quantile(double q) const {
+            std::uint64_t rank = static_cast<std::uint64_t>(q * static_cast<double>(count));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < buckets; ++i) {
+                seen += histogram[i];
+                if (seen > rank) return std::min<std::uint64_t>(std::uint64_t(2) << i, max_ns);
+            }
+            return max_ns;
+        }
+    };
+
+    void add(const TraceStage* stage, std::uint64_t nanos, bool ok) {
+        std::lock_guard<std::mutex> lock(mutex);
+        addLocked(stage, nanos, ok);
+    }
+
+    void add(const result_detail::TraceEvent* events, std::size_t count, double nanos_per_tick) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const TraceStage* last = nullptr;
+        Stage* stage = nullptr;
+        for (std::size_t i = 0; i < count; ++i) {
+            if (events[i].stage != last) {
+                last = events[i].stage;
+                stage = &by_stage[last];
+            }
+            addTo(*stage, static_cast<std::uint64_t>(events[i].ticks * nanos_per_tick), events[i].ok);
+        }
+    }
+
+    void addDropped(std::uint64_t count) {
+        std::lock_guard<std::mutex> lock(mutex);
+        dropped_events += count;
+    }
+
+    // a copy, keyed by stage name
+    std::map<std::string, Stage> stages() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, Stage> out;
+        for (std::map<const TraceStage*, Stage>::const_iterator it = by_stage.begin(); it != by_stage.end(); ++it) {
+            out[it->first->name] = it->second;
+        }
+        return out;
+    }
+
+    std::uint64_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return dropped_events;
+    }
+
+    void write(std::ostream& out) const {
+        std::map<std::string, Stage> snapshot = stages();
+        for (std::map<std::string, Stage>::const_iterator it = snapshot.begin(); it != snapshot.end(); ++it) {
+            const Stage& s = it->second;
+            out << it->first << ": " << s.count << " calls, " << s.errors << " Err, p50 <= " << s.quantile(0.5)
+                << " ns, p99 <= " << s.quantile(0.99) << " ns, max " << s.max_ns << " ns\n";
+        }
+        std::uint64_t lost = dropped();
+        if (lost) out << lost << " events dropped\n";
+    }
+
+private:
+    void addLocked(const TraceStage* stage, std::uint64_t nanos, bool ok) {
+        addTo(by_stage[stage], nanos, ok);   // value-initialised on first sight
+    }
+
+    static void addTo(Stage& s, std::uint64_t nanos, bool ok) {
+        ++s.count;
+        if (!ok) ++s.errors;
+        s.max_ns = std::max(s.max_ns, nanos);
+        std::size_t bucket = 0;
+        while (bucket + 1 < buckets && (nanos >> (bucket + 1)) != 0) ++bucket;
+        ++s.histogram[bucket];
+    }
+
+    mutable std::mutex mutex;
+    std::map<const TraceStage*, Stage> by_stage;
+    std::uint64_t dropped_events = 0;
+};
+
+class ResultTrace {
+public:
+    // moves this thread's events since the last flush into histograms
+    static void flushTo(TraceHistograms& histograms) {
+        result_detail::TraceBuffer& buffer = result_detail::TraceBuffer::local();
+        std::uint64_t pending = buffer.written - buffer.flushed;
+        std::size_t capacity = result_detail::TraceBuffer::capacity;
+        if (pending > capacity) {
+            histograms.addDropped(pending - capacity);
+            pending = capacity;
+        }
+        double scale = result_detail::TraceClock::nanosPerTick();
+        std::size_t first = static_cast<std::size_t>((buffer.written - pending) % capacity);
+        std::size_t head = std::min<std::size_t>(static_cast<std::size_t>(pending), capacity - first);
+        histograms.add(buffer.events + first, head, scale);
+        histograms.add(buffer.events, static_cast<std::size_t>(pending) - head, scale);
+        buffer.flushed = buffer.written;
+    }
+
+    // events recorded on this thread and not yet flushed
+    static std::uint64_t pending() {
+        const result_detail::TraceBuffer& buffer = result_detail::TraceBuffer::local();
+        return buffer.written - buffer.flushed;
+    }
+};
+
+template <typename F>
+result_detail::Traced<F> traced(const TraceStage* stage, F f) {
+    result_detail::Traced<F> step = { stage, std::move(f) };
+    return step;
+}
+
+#else
+
+#define RESULT_STAGE(literal) static_cast<const ::TraceStage*>(nullptr)
+
+template <typename F>
+F traced(const TraceStage*, F f) { return f; }
+
+// flushing and reporting compile either way and do nothing here
+class TraceHistograms {
+public:
+    std::uint64_t dropped() const { return 0; }
+    template <typename Stream>
+    void write(Stream&) const {}
+};
+
+class ResultTrace {
+public:
+    static void flushTo(TraceHistograms&) {}
+    static std::uint64_t pending() { return 0; }
+};
+
+#endif